@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "co.h"
+
+// 生产者/消费者吞吐: test_public 中的轮询队列 (满/空时co_yield重试) 与通道对比。
+// 轮询队列没有加锁, 只在单个M上运行; 通道再在多个M上各测一次
+// 输出每秒传递的元素数和平均每个元素的调度次数 (co_yield或挂起)
+
+#define NUM_PRODUCERS 2
+#define NUM_CONSUMERS 2
+#define ITEMS 1000000
+#define QUEUE_CAP 100
+#define NUM_PROCS 4
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------- 轮询队列 ----------
+
+static long queue[QUEUE_CAP];
+static int q_head, q_size;
+static int produced_done;
+static long consumed_sum;
+static long switches;
+
+static void poll_producer(void *arg) {
+  (void)arg;
+  for (int i = 0; i < ITEMS / NUM_PRODUCERS; ) {
+    if (q_size < QUEUE_CAP) {
+      queue[(q_head + q_size) % QUEUE_CAP] = i + 1;
+      q_size++;
+      i++;
+    }
+    switches++;
+    co_yield();
+  }
+  produced_done++;
+}
+
+static void poll_consumer(void *arg) {
+  (void)arg;
+  while (produced_done < NUM_PRODUCERS || q_size > 0) {
+    if (q_size > 0) {
+      consumed_sum += queue[q_head];
+      q_head = (q_head + 1) % QUEUE_CAP;
+      q_size--;
+    }
+    switches++;
+    co_yield();
+  }
+}
+
+static double bench_poll(double *per_item) {
+  q_head = q_size = produced_done = 0;
+  consumed_sum = switches = 0;
+  long long start = now_ns();
+  struct co *cos[NUM_PRODUCERS + NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    cos[i] = co_start("consumer", poll_consumer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    cos[NUM_CONSUMERS + i] = co_start("producer", poll_producer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS + NUM_CONSUMERS; i++) {
+    co_wait(cos[i]);
+    co_release(cos[i]);
+  }
+  double secs = (now_ns() - start) / 1e9;
+  *per_item = (double)switches / ITEMS;
+  return ITEMS / secs;
+}
+
+// ---------- 通道 ----------
+
+static struct co_chan *chan;
+
+static void chan_producer(void *arg) {
+  (void)arg;
+  for (int i = 0; i < ITEMS / NUM_PRODUCERS; i++) {
+    long v = i + 1;
+    co_chan_send(chan, &v);
+  }
+}
+
+static void chan_consumer(void *arg) {
+  (void)arg;
+  long v, sum = 0;
+  while (co_chan_recv(chan, &v)) {
+    sum += v;
+  }
+  __atomic_fetch_add(&consumed_sum, sum, __ATOMIC_RELAXED);
+}
+
+static double bench_chan(int cap) {
+  chan = co_chan_new(sizeof(long), cap);
+  consumed_sum = 0;
+  long long start = now_ns();
+  struct co *prods[NUM_PRODUCERS], *cons[NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    cons[i] = co_start("consumer", chan_consumer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    prods[i] = co_start("producer", chan_producer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    co_wait(prods[i]);
+    co_release(prods[i]);
+  }
+  co_chan_close(chan);
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    co_wait(cons[i]);
+    co_release(cons[i]);
+  }
+  double secs = (now_ns() - start) / 1e9;
+  co_chan_free(chan);
+  return ITEMS / secs;
+}
+
+static void* idle_thread(void *arg) {
+  (void)arg;
+  return NULL;
+}
+
+int main() {
+  long expected = (long)ITEMS / NUM_PRODUCERS * (ITEMS / NUM_PRODUCERS + 1) / 2 * NUM_PRODUCERS;
+  printf("=== 通道基准 (%d 生产者, %d 消费者, %d 个元素) ===\n",
+         NUM_PRODUCERS, NUM_CONSUMERS, ITEMS);
+
+  double per_item;
+  double poll = bench_poll(&per_item);
+  printf("1个M  轮询队列(cap=%d)  %12.0f 个/s  每个元素 %.2f 次co_yield%s\n",
+         QUEUE_CAP, poll, per_item, consumed_sum == expected ? "" : " (结果错误)");
+  double buffered = bench_chan(QUEUE_CAP);
+  printf("1个M  通道(cap=%d)      %12.0f 个/s%s\n", QUEUE_CAP, buffered,
+         consumed_sum == expected ? "" : " (结果错误)");
+  double unbuffered = bench_chan(0);
+  printf("1个M  无缓冲通道         %12.0f 个/s%s\n", unbuffered,
+         consumed_sum == expected ? "" : " (结果错误)");
+
+  co_set_gomaxprocs(NUM_PROCS);
+  for (int i = 1; i < NUM_PROCS; i++) {
+    co_thread(idle_thread, NULL);
+  }
+  buffered = bench_chan(QUEUE_CAP);
+  printf("%d个M  通道(cap=%d)      %12.0f 个/s%s\n", NUM_PROCS, QUEUE_CAP, buffered,
+         consumed_sum == expected ? "" : " (结果错误)");
+  unbuffered = bench_chan(0);
+  printf("%d个M  无缓冲通道         %12.0f 个/s%s\n", NUM_PROCS, unbuffered,
+         consumed_sum == expected ? "" : " (结果错误)");
+  return 0;
+}
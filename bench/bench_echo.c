@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "co.h"
+
+// 回环echo基准: 每个GOMAXPROCS配置在单独的子进程中运行 (M的数量在进程内只能增加),
+// NUM_CLIENTS个客户端协程各自与服务端协程做ROUNDS次64字节往返, 输出每秒往返次数
+
+#define NUM_CLIENTS 64
+#define ROUNDS 2000
+#define MSG_SIZE 64
+
+static int listen_fd;
+static struct sockaddr_in server_addr;
+static atomic_int failed = 0;
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void echo_conn(void *arg) {
+  int fd = (int)(long)arg;
+  char buf[MSG_SIZE];
+  ssize_t n;
+  while ((n = co_read(fd, buf, sizeof(buf))) > 0) {
+    co_write(fd, buf, n);
+  }
+  co_close(fd);
+}
+
+static void acceptor(void *arg) {
+  (void)arg;
+  struct co_attr attr = { .name = "echo", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    int fd = co_accept(listen_fd, NULL, NULL);
+    if (fd < 0) break;
+    co_start_attr(&attr, echo_conn, (void *)(long)fd);
+  }
+}
+
+static void client(void *arg) {
+  (void)arg;
+  char msg[MSG_SIZE], reply[MSG_SIZE];
+  memset(msg, 'x', sizeof(msg));
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (co_connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    atomic_fetch_add(&failed, 1);
+    co_close(fd);
+    return;
+  }
+  for (int i = 0; i < ROUNDS; i++) {
+    co_write(fd, msg, sizeof(msg));
+    size_t got = 0;
+    while (got < sizeof(reply)) {
+      ssize_t n = co_read(fd, reply + got, sizeof(reply) - got);
+      if (n <= 0) {
+        atomic_fetch_add(&failed, 1);
+        co_close(fd);
+        return;
+      }
+      got += n;
+    }
+  }
+  co_close(fd);
+}
+
+static void* idle_thread(void *arg) {
+  (void)arg;
+  return NULL;
+}
+
+static void run(int procs) {
+  co_set_gomaxprocs(procs);
+  for (int i = 1; i < procs; i++) {
+    co_thread(idle_thread, NULL);
+  }
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
+  socklen_t len = sizeof(server_addr);
+  getsockname(listen_fd, (struct sockaddr *)&server_addr, &len);
+  listen(listen_fd, NUM_CLIENTS);
+
+  long long start = now_ns();
+  struct co *acc = co_start("acceptor", acceptor, NULL);
+  struct co *clients[NUM_CLIENTS];
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    clients[i] = co_start("client", client, NULL);
+  }
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    co_wait(clients[i]);
+  }
+  co_wait(acc);
+  double secs = (now_ns() - start) / 1e9;
+  co_close(listen_fd);
+
+  printf("GOMAXPROCS=%-2d %10.0f 往返/s (%d 连接 x %d 次, 失败 %d)\n",
+         co_get_gomaxprocs(), NUM_CLIENTS * (double)ROUNDS / secs, NUM_CLIENTS, ROUNDS, atomic_load(&failed));
+}
+
+int main() {
+  int max_procs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  printf("=== 回环echo基准 (CPU核数 %d) ===\n", max_procs);
+  fflush(stdout);
+  // 至少测到4个M, 核数不足时可以看到超额订阅的开销
+  int limit = max_procs > 4 ? max_procs : 4;
+  for (int procs = 1; procs <= limit && procs <= 16; procs *= 2) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      run(procs);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "co.h"
+
+// I/O后端对比: epoll 与 io_uring 各在单独的子进程中运行 (后端的fd状态不混用),
+// 1. NUM_FILES个协程各自用co_read/co_write复制一个FILE_SIZE的文件, 输出MB/s
+// 2. NUM_CLIENTS个客户端协程各自与服务端做ROUNDS次64字节往返, 输出每秒往返次数
+
+#define NUM_PROCS 2
+#define NUM_FILES 8
+#define FILE_SIZE (16 * 1024 * 1024)
+#define CHUNK (64 * 1024)
+#define NUM_CLIENTS 64
+#define ROUNDS 2000
+#define MSG_SIZE 64
+
+static char src_path[NUM_FILES][64];
+static char dst_path[NUM_FILES][64];
+static int listen_fd;
+static struct sockaddr_in server_addr;
+static atomic_int failed = 0;
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void copier(void *arg) {
+  int i = (int)(long)arg;
+  int in = open(src_path[i], O_RDONLY);
+  int out = open(dst_path[i], O_WRONLY | O_TRUNC);
+  char *buf = malloc(CHUNK);
+  ssize_t n;
+  while ((n = co_read(in, buf, CHUNK)) > 0) {
+    if (co_write(out, buf, n) != n) {
+      atomic_fetch_add(&failed, 1);
+      break;
+    }
+  }
+  free(buf);
+  co_close(in);
+  co_close(out);
+}
+
+static void echo_conn(void *arg) {
+  int fd = (int)(long)arg;
+  char buf[MSG_SIZE];
+  ssize_t n;
+  while ((n = co_read(fd, buf, sizeof(buf))) > 0) {
+    co_write(fd, buf, n);
+  }
+  co_close(fd);
+}
+
+static void acceptor(void *arg) {
+  (void)arg;
+  struct co_attr attr = { .name = "echo", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    int fd = co_accept(listen_fd, NULL, NULL);
+    if (fd < 0) break;
+    co_start_attr(&attr, echo_conn, (void *)(long)fd);
+  }
+}
+
+static void client(void *arg) {
+  (void)arg;
+  char msg[MSG_SIZE], reply[MSG_SIZE];
+  memset(msg, 'x', sizeof(msg));
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (co_connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    atomic_fetch_add(&failed, 1);
+    co_close(fd);
+    return;
+  }
+  for (int i = 0; i < ROUNDS; i++) {
+    co_write(fd, msg, sizeof(msg));
+    size_t got = 0;
+    while (got < sizeof(reply)) {
+      ssize_t n = co_read(fd, reply + got, sizeof(reply) - got);
+      if (n <= 0) {
+        atomic_fetch_add(&failed, 1);
+        co_close(fd);
+        return;
+      }
+      got += n;
+    }
+  }
+  co_close(fd);
+}
+
+static void* idle_thread(void *arg) {
+  (void)arg;
+  return NULL;
+}
+
+static double bench_copy() {
+  long long start = now_ns();
+  struct co *copiers[NUM_FILES];
+  for (int i = 0; i < NUM_FILES; i++) {
+    copiers[i] = co_start("copier", copier, (void *)(long)i);
+  }
+  for (int i = 0; i < NUM_FILES; i++) {
+    co_wait(copiers[i]);
+  }
+  double secs = (now_ns() - start) / 1e9;
+  return NUM_FILES * (double)FILE_SIZE / (1024 * 1024) / secs;
+}
+
+static double bench_echo() {
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
+  socklen_t len = sizeof(server_addr);
+  getsockname(listen_fd, (struct sockaddr *)&server_addr, &len);
+  listen(listen_fd, NUM_CLIENTS);
+
+  long long start = now_ns();
+  struct co *acc = co_start("acceptor", acceptor, NULL);
+  struct co *clients[NUM_CLIENTS];
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    clients[i] = co_start("client", client, NULL);
+  }
+  for (int i = 0; i < NUM_CLIENTS; i++) {
+    co_wait(clients[i]);
+  }
+  co_wait(acc);
+  double secs = (now_ns() - start) / 1e9;
+  co_close(listen_fd);
+  return NUM_CLIENTS * (double)ROUNDS / secs;
+}
+
+static void run(int backend) {
+  co_set_gomaxprocs(NUM_PROCS);
+  for (int i = 1; i < NUM_PROCS; i++) {
+    co_thread(idle_thread, NULL);
+  }
+  if (co_set_io_backend(backend) != backend) {
+    printf("%-8s 不可用, 跳过\n", "io_uring");
+    return;
+  }
+  const char *name = backend == CO_IO_URING ? "io_uring" : "epoll";
+  double copy = bench_copy();
+  double echo = bench_echo();
+  printf("%-8s 文件复制 %8.0f MB/s   回环echo %10.0f 往返/s (失败 %d)\n",
+         name, copy, echo, atomic_load(&failed));
+}
+
+int main() {
+  printf("=== I/O后端基准 (GOMAXPROCS=%d, %d x %dMB 文件, %d 连接 x %d 次) ===\n",
+         NUM_PROCS, NUM_FILES, FILE_SIZE >> 20, NUM_CLIENTS, ROUNDS);
+  fflush(stdout);
+
+  char *data = malloc(CHUNK);
+  memset(data, 'x', CHUNK);
+  for (int i = 0; i < NUM_FILES; i++) {
+    strcpy(src_path[i], "/tmp/co_bench_src_XXXXXX");
+    strcpy(dst_path[i], "/tmp/co_bench_dst_XXXXXX");
+    int src = mkstemp(src_path[i]);
+    int dst = mkstemp(dst_path[i]);
+    for (int off = 0; off < FILE_SIZE; off += CHUNK) {
+      ssize_t ret = write(src, data, CHUNK);
+      (void)ret;
+    }
+    close(src);
+    close(dst);
+  }
+  free(data);
+
+  int backends[] = { CO_IO_EPOLL, CO_IO_URING };
+  for (int i = 0; i < 2; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      run(backends[i]);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+  }
+
+  for (int i = 0; i < NUM_FILES; i++) {
+    unlink(src_path[i]);
+    unlink(dst_path[i]);
+  }
+  return 0;
+}
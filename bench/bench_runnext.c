@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "co.h"
+
+// runnext基准: 分别以 CO_RUNNEXT=0 和默认设置重新执行自己, 对比
+// 1. 通道乒乓: 两个协程通过无缓冲通道来回传递, 同时有 NUM_BUSY 个不断co_yield的协程
+// 2. 通道生产者/消费者 (cap=QUEUE_CAP)
+// 3. test_public 中的轮询队列: 满/空时co_yield重试, 不经过唤醒, runnext不起作用
+// 每项输出1个P和 NUM_PROCS 个P下的吞吐
+
+#define ROUNDS 200000
+#define NUM_BUSY 8
+#define ITEMS 1000000
+#define QUEUE_CAP 100
+#define NUM_PRODUCERS 2
+#define NUM_CONSUMERS 2
+#define NUM_PROCS 4
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------- 乒乓 ----------
+
+static struct co_chan *ping, *pong;
+static volatile int stop;
+
+static void busy(void *arg) {
+  (void)arg;
+  while (!stop) {
+    co_yield();
+  }
+}
+
+static void pinger(void *arg) {
+  (void)arg;
+  for (long i = 0; i < ROUNDS; i++) {
+    co_chan_send(ping, &i);
+    co_chan_recv(pong, &i);
+  }
+}
+
+static void ponger(void *arg) {
+  (void)arg;
+  long v;
+  for (long i = 0; i < ROUNDS; i++) {
+    co_chan_recv(ping, &v);
+    co_chan_send(pong, &v);
+  }
+}
+
+static double bench_pingpong() {
+  ping = co_chan_new(sizeof(long), 0);
+  pong = co_chan_new(sizeof(long), 0);
+  stop = 0;
+  struct co *bs[NUM_BUSY];
+  for (int i = 0; i < NUM_BUSY; i++) {
+    bs[i] = co_start("busy", busy, NULL);
+  }
+  long long start = now_ns();
+  struct co *a = co_start("pinger", pinger, NULL);
+  struct co *b = co_start("ponger", ponger, NULL);
+  co_wait(a);
+  co_wait(b);
+  double secs = (now_ns() - start) / 1e9;
+  stop = 1;
+  co_release(a);
+  co_release(b);
+  for (int i = 0; i < NUM_BUSY; i++) {
+    co_wait(bs[i]);
+    co_release(bs[i]);
+  }
+  co_chan_free(ping);
+  co_chan_free(pong);
+  return ROUNDS / secs;
+}
+
+// ---------- 通道生产者/消费者 ----------
+
+static struct co_chan *chan;
+
+static void chan_producer(void *arg) {
+  (void)arg;
+  for (long i = 0; i < ITEMS / NUM_PRODUCERS; i++) {
+    co_chan_send(chan, &i);
+  }
+}
+
+static void chan_consumer(void *arg) {
+  (void)arg;
+  long v;
+  while (co_chan_recv(chan, &v)) {
+  }
+}
+
+static double bench_chan() {
+  chan = co_chan_new(sizeof(long), QUEUE_CAP);
+  long long start = now_ns();
+  struct co *prods[NUM_PRODUCERS], *cons[NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    cons[i] = co_start("consumer", chan_consumer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    prods[i] = co_start("producer", chan_producer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    co_wait(prods[i]);
+    co_release(prods[i]);
+  }
+  co_chan_close(chan);
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    co_wait(cons[i]);
+    co_release(cons[i]);
+  }
+  double secs = (now_ns() - start) / 1e9;
+  co_chan_free(chan);
+  return ITEMS / secs;
+}
+
+// ---------- 轮询队列 (test_public) ----------
+
+static long queue[QUEUE_CAP];
+static int q_head, q_size;
+static int produced_done;
+
+static void poll_producer(void *arg) {
+  (void)arg;
+  for (int i = 0; i < ITEMS / NUM_PRODUCERS; ) {
+    if (q_size < QUEUE_CAP) {
+      queue[(q_head + q_size) % QUEUE_CAP] = i + 1;
+      q_size++;
+      i++;
+    }
+    co_yield();
+  }
+  produced_done++;
+}
+
+static void poll_consumer(void *arg) {
+  (void)arg;
+  while (produced_done < NUM_PRODUCERS || q_size > 0) {
+    if (q_size > 0) {
+      q_head = (q_head + 1) % QUEUE_CAP;
+      q_size--;
+    }
+    co_yield();
+  }
+}
+
+// 轮询队列没有加锁, 只在单个P上运行
+static double bench_poll() {
+  q_head = q_size = produced_done = 0;
+  long long start = now_ns();
+  struct co *cos[NUM_PRODUCERS + NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++) {
+    cos[i] = co_start("consumer", poll_consumer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS; i++) {
+    cos[NUM_CONSUMERS + i] = co_start("producer", poll_producer, NULL);
+  }
+  for (int i = 0; i < NUM_PRODUCERS + NUM_CONSUMERS; i++) {
+    co_wait(cos[i]);
+    co_release(cos[i]);
+  }
+  return ITEMS / ((now_ns() - start) / 1e9);
+}
+
+static void run() {
+  const char *env = getenv("CO_RUNNEXT");
+  const char *mode = env && strcmp(env, "0") == 0 ? "关" : "开";
+  co_set_gomaxprocs(1);
+  double poll = bench_poll();
+  double pp1 = bench_pingpong();
+  double chan1 = bench_chan();
+  co_set_gomaxprocs(NUM_PROCS);
+  double pp4 = bench_pingpong();
+  double chan4 = bench_chan();
+  printf("runnext%s  乒乓 %10.0f / %10.0f 往返/s  通道 %10.0f / %10.0f 个/s  轮询队列 %10.0f 个/s\n",
+         mode, pp1, pp4, chan1, chan4, poll);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    run();
+    return 0;
+  }
+  printf("=== runnext基准 (乒乓 %d 次, 忙协程 %d 个; 生产者/消费者 %d 个元素; 1个P / %d个P) ===\n",
+         ROUNDS, NUM_BUSY, ITEMS, NUM_PROCS);
+  fflush(stdout);
+  for (int on = 0; on <= 1; on++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      if (!on) {
+        setenv("CO_RUNNEXT", "0", 1);
+      }
+      execl("/proc/self/exe", argv[0], "run", (char *)NULL);
+      _exit(1);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
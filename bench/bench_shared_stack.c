@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "co.h"
+
+// 共享栈基准: 对比私有栈与共享栈模式下
+//   1. 每个空闲协程占用的内存 (RSS)
+//   2. 两个协程之间 co_yield 往返的切换耗时
+
+#define NUM_IDLE 10000
+#define PINGPONG_ROUNDS 100000
+
+static int idle_flags;
+static long rss_peak;
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long rss_kb() {
+  long size = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 每个协程创建下一个并等待它, 最后一个协程运行时所有协程都处于等待状态
+static void idle_chain(void *arg) {
+  long index = (long)arg;
+  if (index == NUM_IDLE - 1) {
+    rss_peak = rss_kb();
+    return;
+  }
+  struct co_attr attr = { .name = "idle", .stack_size = 0, .flags = idle_flags };
+  struct co *next = co_start_attr(&attr, idle_chain, (void *)(index + 1));
+  co_wait(next);
+}
+
+static double bench_idle_memory(int flags) {
+  idle_flags = flags;
+  long before = rss_kb();
+  struct co_attr attr = { .name = "idle", .stack_size = 0, .flags = flags };
+  struct co *first = co_start_attr(&attr, idle_chain, (void *)0L);
+  co_wait(first);
+  return (double)(rss_peak - before) / NUM_IDLE;
+}
+
+static void pingpong(void *arg) {
+  (void)arg;
+  for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+    co_yield();
+  }
+}
+
+static double bench_switch(int flags) {
+  struct co_attr attr = { .name = "pingpong", .stack_size = 0, .flags = flags };
+  long long start = now_ns();
+  struct co *a = co_start_attr(&attr, pingpong, NULL);
+  struct co *b = co_start_attr(&attr, pingpong, NULL);
+  co_wait(a);
+  co_wait(b);
+  long long end = now_ns();
+  return (double)(end - start) / (2.0 * PINGPONG_ROUNDS);
+}
+
+int main() {
+  double private_kb = bench_idle_memory(0);
+  double shared_kb = bench_idle_memory(CO_ATTR_SHARED_STACK);
+  double private_ns = bench_switch(0);
+  double shared_ns = bench_switch(CO_ATTR_SHARED_STACK);
+
+  printf("=== 共享栈基准 ===\n");
+  printf("空闲协程内存 (%d 个): 私有栈 %8.2f KB/协程, 共享栈 %8.2f KB/协程\n",
+         NUM_IDLE, private_kb, shared_kb);
+  printf("co_yield 切换 (%d 轮): 私有栈 %8.2f ns/switch, 共享栈 %8.2f ns/switch\n",
+         PINGPONG_ROUNDS, private_ns, shared_ns);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <ucontext.h>
+#include "context.h"
+
+// 上下文切换微基准: 两个上下文之间来回切换, 统计每次切换的平均耗时 (ns)
+// 对比手写汇编切换 (co_context_switch) 与 glibc 的 swapcontext
+
+#define ITERATIONS 10000000
+#define STACK_SIZE (1 << 16)
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------- co_context ----------
+
+static co_context_t main_ctx, peer_ctx;
+
+static void peer_entry() {
+  while (1) {
+    co_context_switch(&peer_ctx, &main_ctx);
+  }
+}
+
+static double bench_co_context() {
+  uint8_t *stack = malloc(STACK_SIZE);
+  co_context_init(&peer_ctx, stack, STACK_SIZE, peer_entry);
+
+  long long start = now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    co_context_switch(&main_ctx, &peer_ctx);
+  }
+  long long end = now_ns();
+
+  free(stack);
+  return (double)(end - start) / (2.0 * ITERATIONS);
+}
+
+// ---------- ucontext ----------
+
+static ucontext_t main_uc, peer_uc;
+
+static void peer_uc_entry() {
+  while (1) {
+    swapcontext(&peer_uc, &main_uc);
+  }
+}
+
+static double bench_ucontext() {
+  uint8_t *stack = malloc(STACK_SIZE);
+  getcontext(&peer_uc);
+  peer_uc.uc_stack.ss_sp = stack;
+  peer_uc.uc_stack.ss_size = STACK_SIZE;
+  peer_uc.uc_link = NULL;
+  makecontext(&peer_uc, peer_uc_entry, 0);
+
+  long long start = now_ns();
+  for (int i = 0; i < ITERATIONS; i++) {
+    swapcontext(&main_uc, &peer_uc);
+  }
+  long long end = now_ns();
+
+  free(stack);
+  return (double)(end - start) / (2.0 * ITERATIONS);
+}
+
+int main() {
+  printf("=== 上下文切换基准 (%d 次往返) ===\n", ITERATIONS);
+#ifdef CO_USE_UCONTEXT
+  printf("co_context 实现: ucontext\n");
+#else
+  printf("co_context 实现: asm\n");
+#endif
+  double co_ns = bench_co_context();
+  double uc_ns = bench_ucontext();
+  printf("co_context_switch: %6.2f ns/switch\n", co_ns);
+  printf("swapcontext:       %6.2f ns/switch\n", uc_ns);
+  printf("加速比:            %6.2fx\n", uc_ns / co_ns);
+  return 0;
+}
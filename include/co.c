@@ -1,20 +1,83 @@
+#define _GNU_SOURCE  // accept4
+
 #include "co.h"
-#include "list.h"
+#include "context.h"
+#include "deque.h"
+#include "trace.h"
+#include "uring.h"
 #include <assert.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <ucontext.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/sysinfo.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <linux/mempolicy.h>
 
-#define DEBUG_PRINT(fmt, ...) printf("\033[33m[TID:%ld][debug] " fmt "\033[0m\n", pthread_self(), ##__VA_ARGS__)
+// 日志级别 (make LOG_LEVEL=n): 0 关闭 (默认), 1 运行时/线程级别的事件, 2 调度热路径的每一步
+// 关闭时日志语句仍参与类型检查, 但会被编译器整体删除
+#ifndef CO_LOG_LEVEL
+#define CO_LOG_LEVEL 0
+#endif
+#define CO_LOG(level, tag, fmt, ...) do { \
+    if (CO_LOG_LEVEL >= (level)) { \
+      printf("\033[33m[TID:%ld][" tag "] " fmt "\033[0m\n", pthread_self(), ##__VA_ARGS__); \
+    } \
+  } while (0)
+#define INFO_PRINT(fmt, ...) CO_LOG(1, "info", fmt, ##__VA_ARGS__)
+#define DEBUG_PRINT(fmt, ...) CO_LOG(2, "debug", fmt, ##__VA_ARGS__)
 
-#define STACK_SIZE (1 << 16)  // 栈 64KB
-#define MAX_LOCAL_QUEUE 4
+#define STACK_SIZE (1 << 16)  // 默认栈 64KB
+#define STACK_MIN_SIZE (1 << 14)  // 最小栈 16KB
+#define MAX_LOCAL_QUEUE 256  // private/public队列容量, 2的幂
+#define GLOBAL_QUEUE_CHECK_INTERVAL 61  // 每调度这么多次优先检查一次全局队列
+#define PRIO_LEVELS (CO_PRIO_MAX + 1)  // CO_SCHED_PRIORITY的优先级链表数, 不超过32
+#define FAIR_STARVE_NS 10000000ULL  // CO_SCHED_FAIR: 有协程等待的调度类超过10ms没有运行时, 先于更高的类运行
+#define FAIR_LAG_NS 20000000ULL     // 放入队列时虚拟运行时间与所在类的最小值最多相差20ms
+#define RUNNEXT_STEAL_US 3     // 其它P的runnext至少等这么久才偷取, 唤醒者很快挂起时仍由它的P直接交接
+#define RUNNEXT_MAX 16        // runnext连续运行的次数上限, 之后放回本地队列与其它协程一起选择
+#define WAITERS_CLOSED ((struct co *)1)  // 协程已结束, 等待列表不再接受新的等待者
+#define POLL_READY ((struct co *)1)  // fd已就绪, 还没有协程等待
+#define POLL_PAGE_SIZE 1024   // fd描述符表两级索引, 每页1024个
+#define POLL_PAGES 1024       // 最多支持 1024*1024 个fd
+#define POLL_EVENTS 128       // 每次epoll_wait最多取回的事件数
+#define URING_ENTRIES 256     // 每个P的io_uring提交队列长度
+#define URING_RW_MAX 0x7ffff000  // 单次读写的上限, 与read/write相同
+#define TIMER_TICK_SHIFT 16   // 时间轮刻度 2^16ns, 约65us
+#define TIMER_LEVEL_BITS 6    // 每层64个槽
+#define TIMER_LEVELS 5        // 共覆盖 2^46ns (约19.5小时), 更远的定时器放在最高层, 取出时重新插入
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS)
+#define WAIT_NODE_TAG 1       // 等待列表中最低位为1的指针指向struct wait_node
+#define SPIN_MIN 16           // 空闲M休眠前自旋检查次数的下限
+#define SPIN_MAX 1024         // 空闲M休眠前自旋检查次数的上限
+#define SPIN_PAUSE 32         // 两次检查之间的pause指令数
+#define MUTEX_SPIN 4          // co_mutex挂起前自旋重试的次数
+#define MUTEX_STARVE_NS 1000000ULL  // 等待超过1ms的协程让co_mutex进入饥饿模式
+#define STACK_CACHE_MAX 16    // 每个P缓存的空闲栈上限, 超出时一半溢出到全局栈池
+#define STACK_POOL_MAX 256    // 全局栈池上限, 超出时直接munmap
+#define SHARED_STACK_SIZE (1 << 18)  // 每个P的共享执行栈 256KB
+#define CO_NAME_MAX 32        // 协程名字的内联存储, 包含结尾的'\0'
+#define CO_CACHE_MAX 64       // 每个P缓存的空闲协程控制块上限, 超出时一半溢出到全局池
+#define CO_SLAB_SIZE 64       // 全局池为空时一次分配的控制块数量
+#define MAX_MACHINES 256      // M的上限, 阻塞调用交出P后M可以多于P
+#define SYSMON_RETAKE_NS 20000ULL       // P处于阻塞调用超过20us且有工作时转交给其它M
+#define SYSMON_MIN_DELAY_NS 20000ULL    // sysmon检查间隔, 连续空闲时加倍直到上限
+#define SYSMON_MAX_DELAY_NS 10000000ULL
+#define PREEMPT_SIGNAL SIGURG          // 异步抢占使用的信号, 默认动作是忽略
+#define PREEMPT_STACK_MIN 4096         // 协程栈剩余不足时不在信号处理函数中调度
+#define MAX_NUMA_NODES 64              // 读取拓扑时检查的节点编号上限
 
 typedef enum {
   CO_NEW,
@@ -23,37 +86,171 @@ typedef enum {
   CO_DEAD
 } co_status_t;
 
+struct processor;
+struct wait_node;
+
+// 定时器, 嵌入在struct co中; 挂在某个P的时间轮上时p非NULL
+struct timer {
+  struct timer *next;
+  struct timer **pprev;
+  uint64_t expires;              // 到期的刻度
+  int level;                     // 所在的层和槽
+  int slot;
+  _Atomic(struct processor *) p;
+  struct wait_node *node;        // co_wait_timeout的等待节点, co_sleep时为NULL
+};
+
+// co_wait_timeout的等待节点: 超时返回后节点仍可能留在目标的等待列表中, 所以单独分配,
+// 由等待列表和等待者各持有一个引用。目标结束和定时器到期通过交换g争夺唤醒权
+struct wait_node {
+  struct co *next;               // 等待列表中的下一项
+  _Atomic(struct co *) g;        // 被唤醒后为NULL
+  atomic_int refs;
+  int timed_out;
+};
+
 // 协程控制块 (G)
 struct co {
-  char *name;
+  char name[CO_NAME_MAX];  // 超长的名字被截断, 不需要额外分配
+  atomic_int refs;      // 运行中的协程和co_start返回的句柄各持有一个引用, 归零后回收控制块
   void (*func)(void *);
   void *arg;
 
   co_status_t status;
-  struct list waiters;
-  ucontext_t context;
-  uint8_t *stack;
+  // 等待本协程结束的协程, 通过wait_next串成无锁栈; 结束时换成WAITERS_CLOSED
+  _Atomic(struct co *) waiters;
+  struct co *wait_next;
+  co_context_t context;
+  uint8_t *stack;       // mmap映射的起始地址, 最低一页为保护页
+  size_t stack_size;    // 可用栈大小, 不含保护页
+  int flags;            // CO_ATTR_* 标志
+
+  // 共享栈模式: 协程只能在所属P的共享栈上运行, 切换离开后已用部分拷贝到save_buf
+  struct processor *home;
+  uint8_t *save_buf;
+  size_t save_size;
 
   struct co *next;
+  uint64_t id;          // 追踪事件中使用的协程id
+  struct timer timer;   // co_sleep / co_wait_timeout使用
+  int sync_handoff;     // co_mutex解锁时直接把锁交给了本协程
+  int priority;         // 0到CO_PRIO_MAX, CO_SCHED_PRIORITY策略下决定在private队列中的顺序
+  int nopreempt;        // 大于0时在运行时内部, 不能被异步抢占
+  int sched_class;      // enum co_sched_class
+  int weight;           // 1到CO_WEIGHT_MAX
+  uint64_t vruntime;    // 按权重折算的运行时间 (ns), CO_SCHED_FAIR策略下越小越先运行
+};
+
+struct co_slab {
+  struct co_slab *next;
+  struct co cos[CO_SLAB_SIZE];
+};
+
+// 每个fd的轮询状态; rg/wg为 NULL、POLL_READY 或等待读/写的协程
+struct poll_desc {
+  _Atomic(struct co *) rg;
+  _Atomic(struct co *) wg;
+  atomic_int registered;
+  struct processor *ring_owner;  // 非NULL表示这是该P的io_uring完成通知eventfd
+};
+
+// 挂起在io_uring请求上的协程, 位于协程自己的栈上, 地址作为SQE的user_data
+struct uring_req {
+  struct co *g;
+  int res;
+};
+
+// CO_SCHED_FAIR下P的一个调度类: 按vruntime排序的最小堆, 选择和放入都是O(log n)
+struct fair_class {
+  struct co *heap[MAX_LOCAL_QUEUE];
+  int size;
+  uint64_t min_vruntime;  // 已选中协程的最大vruntime, 单调增加, 新放入的协程以此为基准
+  uint64_t since;         // 上次被选中或开始有协程等待的时刻, 用于防饿死
+  unsigned long runtime_ns;
+  unsigned long runs;
+  unsigned long starved_runs;
 };
 
 // 协程调度器 (P)
 struct processor {
   int id;
   
+  // private队列: CO_SCHED_PRIORITY时为每个优先级一个链表 (通过next串起, bitmap记录非空的级别),
+  // CO_SCHED_FAIR时为每个调度类一个最小堆, 否则为环形数组, 队头是最早放入的。只有P自己访问
   struct co *private_queue[MAX_LOCAL_QUEUE];
   int private_head;
   int private_tail;
   int private_size;
+  struct co *prio_head[PRIO_LEVELS];
+  struct co *prio_tail[PRIO_LEVELS];
+  uint32_t prio_bitmap;
+  struct fair_class fair[CO_CLASS_COUNT];
+  uint64_t fair_now;        // CO_SCHED_FAIR: 上一次调度的时刻, 当前协程从这时开始运行
+  int policy;               // enum co_sched_policy
+  unsigned int policy_gen;  // 已经应用的runtime.policy_gen
   
-  struct co *public_queue[MAX_LOCAL_QUEUE];
-  int public_head;
-  int public_tail;
-  int public_size;
-  pthread_mutex_t public_mutex;
+  // 无锁工作窃取队列: P自己在bottom端放入/取出, 其它P从top端偷取
+  struct deque public_queue;
   
   struct co *current_g;
   struct machine *m;
+  unsigned int schedtick;  // 调度次数, 用于定期检查全局队列
+  // 被当前协程唤醒的协程, 当前协程让出后优先运行。P自己用atomic_exchange放入和取出;
+  // 其它P只在没有别的工作时等待RUNNEXT_STEAL_US后用CAS偷取, 唤醒者之后长时间计算也不会耽误它
+  _Atomic(struct co *) runnext;
+  int runnext_streak;      // 连续从runnext取得协程的次数
+  uint64_t rand_state;     // 调度用的xorshift状态, 只有P自己访问
+
+  // 默认大小的空闲栈缓存, 栈顶存放下一个空闲栈的指针, 只有P自己访问
+  uint8_t *stack_cache;
+  int stack_cache_size;
+  unsigned long stack_hits;
+  unsigned long stack_misses;
+
+  // 空闲的协程控制块, 通过next串起来, 只有P自己访问
+  struct co *co_cache;
+  int co_cache_size;
+
+  // 共享执行栈及当前占用它的协程
+  uint8_t *shared_stack;
+  struct co *shared_owner;
+  // 其它P唤醒的共享栈协程先放入这里, 由P自己移入private队列
+  struct co *shared_queue_head;
+  struct co *shared_queue_tail;
+  atomic_int shared_queue_size;  // 空闲M检查是否有工作时无锁读取
+  pthread_mutex_t shared_mutex;
+
+  // io_uring: 第一次使用时创建, 只有P自己访问。协程填写SQE后挂起,
+  // 本P没有其它可运行的协程时一次提交, 完成事件由P自己收割
+  struct uring ring;
+  int ring_inflight;        // 已填写还没有收割的请求数
+  int ring_efd;             // 有完成事件时内核写入, 注册在epoll中唤醒休眠的M
+  struct poll_desc ring_pd;
+
+  // 分层时间轮: 第L层的槽覆盖64^L个刻度, bitmap记录非空的槽, 插入和到期都是O(1)。
+  // 只有P自己插入和处理到期, 其它P上被提前唤醒的协程取消定时器时也会访问, 由timer_mutex保护
+  pthread_mutex_t timer_mutex;
+  struct timer *wheel[TIMER_LEVELS][TIMER_SLOTS];
+  uint64_t wheel_bitmap[TIMER_LEVELS];
+  uint64_t wheel_tick;          // 已处理到的刻度
+  atomic_int timer_count;
+  _Atomic uint64_t timer_next;  // 最早到期时间的下界 (ns), 空闲M据此决定休眠多久
+
+  // 正阻塞在co_enter_blocking/co_exit_blocking之间的M, 否则为NULL。阻塞调用返回的M与sysmon
+  // 通过CAS争夺P; 记录M而不是状态位, P被转交后新M的阻塞调用不会让旧M的CAS误成功
+  _Atomic(struct machine *) syscall_m;
+  uint64_t syscall_when;        // 进入阻塞调用的时刻
+
+  // 异步抢占: sysmon上次看到的调度计数及其时刻 (只有sysmon访问), 被抢占的次数
+  unsigned int preempt_tick;
+  uint64_t preempt_when;
+  unsigned long preempts;
+
+  // CPU亲和性: 开启时P的M绑定到cpu, node为其NUMA节点; 关闭时cpu为-1, node为0
+  int cpu;
+  int node;
+  unsigned long steals;         // 偷取成功的次数, 只有P自己修改
+  unsigned long remote_steals;  // 其中目标P在其它节点上的次数
 };
 
 // 内核线程 (M)
@@ -61,26 +258,116 @@ struct machine {
   pthread_t thread;
   struct processor *p;
   int spinning;
+
+  co_context_t g0;      // G0 调度上下文
+  uint8_t *g0_stack;    // 仅M0需要单独分配G0栈, 其余M的G0运行在线程栈上
+  struct co *dead_g;    // 已结束的协程, 切换离开后才能释放其栈
+  struct co *shared_next;  // 等待G0换入共享栈后运行的协程
+  struct co *ready_g;   // 调用co_yield的协程, 切换离开后才放回队列, 避免被其它M提前运行
+  struct co *wait_g;    // 调用co_wait的协程, 切换离开后才加入wait_target的等待列表
+  struct co *wait_target;
+  struct wait_node *wait_node;  // co_wait_timeout时以节点代替协程加入等待列表
+  struct co *timer_g;   // 调用co_sleep等的协程, 切换离开后才启动它的定时器
+  struct co *poll_g;    // 调用co_read等挂起的协程, 切换离开后才登记到poll_slot
+  _Atomic(struct co *) *poll_slot;
+  // 挂起在同步原语/通道上的协程切换离开后才调用park_unlock(park_arg)释放等待队列的锁
+  void (*park_unlock)(void *);
+  void *park_arg;
+
+  // 空闲休眠: 自旋 spin_budget 次仍没有工作则在park_cond上休眠, 由有新工作的M唤醒
+  pthread_cond_t park_cond;
+  int parked;           // 在空闲M列表中, 受idle_mutex保护
+  int woken;            // 被唤醒后还没有找到工作
+  uint64_t wake_ns;     // 被唤醒的时刻, 用于统计唤醒延迟
+  int spin_budget;
+
+  struct trace_ring trace;  // 调度事件, 只在定义CO_TRACE时分配
+
+  struct co *syscall_g; // 在co_enter_blocking与co_exit_blocking之间的协程
+  struct co *exit_g;    // 阻塞调用返回时P已被转交, 切换离开后放入全局队列
 };
 
 // 全局状态
 static struct {
   struct co *global_queue_head;
   struct co *global_queue_tail;
-  int global_queue_size;
+  atomic_int global_queue_size;  // 修改时持有global_mutex, 空闲M检查时无锁读取
   pthread_mutex_t global_mutex;
     
   struct processor *processors[64];
-  struct machine *machines[64];
+  struct machine *machines[MAX_MACHINES];
   int num_processors;
   int num_machines;
     
-  struct co *dead_queue_head;
-  struct co *dead_queue_tail;
-  int dead_queue_size;
-  pthread_mutex_t dead_mutex;
+  uint8_t *stack_pool;         // 全局空闲栈池
+  int stack_pool_size;
+  unsigned long stack_spills;
+  unsigned long stack_refills;
+  pthread_mutex_t stack_mutex;
+  size_t page_size;            // 保护页大小
+    
+  // 协程控制块按slab批量分配, 只在退出时整体释放; 结束且句柄已释放的控制块回到P的缓存
+  struct co *co_pool;          // 全局空闲控制块池
+  int co_pool_size;
+  struct co_slab *co_slabs;
+  pthread_mutex_t co_mutex;
     
-  int gomaxprocs;
+  // 休眠的M; nr_idle与nr_spinning用于唤醒方无锁判断是否需要唤醒
+  struct machine *idle_machines[64];
+  int num_idle_machines;
+  pthread_mutex_t idle_mutex;
+  atomic_int nr_idle;
+  atomic_int nr_spinning;
+  unsigned long parks;
+  unsigned long wakeups;
+  unsigned long spurious_wakeups;
+  uint64_t wake_latency_total_ns;
+  uint64_t wake_latency_max_ns;
+
+  // 没有P的备用M, 等待sysmon转交阻塞调用中的P; 受idle_mutex保护
+  struct machine *spare_machines[MAX_MACHINES];
+  int num_spare_machines;
+  int spare_spawning;          // 已经创建了新的备用M, 还没有加入列表
+  unsigned long syscall_handoffs;
+  unsigned long workers_started;  // 按需启动的工作M数量
+
+  // sysmon: 第一次调用co_enter_blocking时启动, 没有阻塞调用时在sysmon_cond上休眠
+  pthread_once_t sysmon_once;
+  pthread_t sysmon_thread;
+  int sysmon_started;
+  pthread_mutex_t sysmon_mutex;
+  pthread_cond_t sysmon_cond;
+  atomic_int sysmon_parked;
+  atomic_int nr_syscall;       // 处于阻塞调用中的协程数
+
+  _Atomic uint64_t preempt_ns; // 异步抢占的时间片, 0表示关闭
+  int preempt_installed;
+
+  // CPU亲和性: 第一次开启时读取允许的CPU和NUMA拓扑, 修改时持有idle_mutex
+  int affinity;
+  int num_cpus;                // 允许使用的CPU数, 0表示还没有读取
+  int numa_nodes;              // 允许的CPU分布在几个节点上
+  int cpu_order[CPU_SETSIZE];  // 按 (节点, CPU编号) 排序, P的id依次对应
+  int cpu_node[CPU_SETSIZE];
+  cpu_set_t cpu_allowed;       // 开启前的亲和性掩码, 关闭时恢复
+
+  _Atomic uint64_t next_co_id;
+
+  // 网络轮询: 第一次使用co_read等时初始化
+  int epfd;
+  int wakefd;                  // eventfd, 唤醒阻塞在epoll_wait中的M
+  pthread_once_t netpoll_once;
+  _Atomic(struct poll_desc *) poll_table[POLL_PAGES];
+  atomic_int netpoll_waiters;  // 挂起在fd上的协程数
+  _Atomic(struct machine *) netpoll_m;  // 阻塞在epoll_wait中的M, 修改时持有idle_mutex
+  atomic_int io_backend;       // CO_IO_EPOLL 或 CO_IO_URING
+  int uring_supported;         // -1 还没有探测
+
+  int gomaxprocs;        // 运行中会被co_set_gomaxprocs修改, 其它M用__atomic_load_n读取
+  int policy;           // co_set_sched_policy设置的调度策略, 新的P也使用它
+  atomic_uint policy_gen;  // 每次co_set_sched_policy加一, 各P调度时发现变化再切换
+  int runnext;          // 0时唤醒的协程和其它协程一样进入public队列 (CO_RUNNEXT=0, 用于对比)
+  uint64_t sched_seed;  // 每个P的随机数种子由它和P的id导出
   int initialized;
 } runtime;
 
@@ -91,19 +378,87 @@ static struct co main_co = {0};
 static struct machine main_machine = {0};
 static struct processor main_processor = {0};
 
+// 运行时内部不能被异步抢占: 导出函数入口处增加当前协程的计数, 返回时减少。
+// 计数记在协程上而不是M上, 函数中途换到其它M继续执行时仍然配对
+static inline struct co* preempt_disable() {
+  struct co *g = current_p ? current_p->current_g : NULL;
+  if (g) {
+    g->nopreempt++;
+    atomic_signal_fence(memory_order_seq_cst);
+  }
+  return g;
+}
+
+static inline void preempt_enable(struct co **g) {
+  if (*g) {
+    atomic_signal_fence(memory_order_seq_cst);
+    (*g)->nopreempt--;
+  }
+}
+
+// id超出GOMAXPROCS的P (co_set_gomaxprocs缩小后), 不再运行可迁移的协程
+static inline int processor_retired(struct processor *p) {
+  return p->id >= __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED);
+}
+
+#define NO_PREEMPT() \
+  struct co *no_preempt_g __attribute__((cleanup(preempt_enable), unused)) = preempt_disable()
+
 static void runtime_init();
-static struct co* global_queue_pop();
-static void global_queue_push(struct co *g);
+static struct co* global_queue_pop(struct processor *p, int max);
+static void global_queue_push_batch(struct co *head, struct co *tail, int n);
 static struct co* local_queue_pop(struct processor *p);
 static void local_queue_push(struct processor *p, struct co *g);
-// static struct co* public_queue_pop(struct processor *p);
 static void public_queue_push(struct processor *p, struct co *g);
+static void shared_queue_push(struct processor *p, struct co *g);
 static void move_public_to_private(struct processor *p);
+static void processor_set_policy(struct processor *p, int policy);
+static void co_ready(struct co *g);
+static void co_ready_next(struct co *g);
+static void wait_list_add(struct co *target, struct co *g);
 static struct co* steal_work(struct processor *p);
 static void schedule();
+static void schedule_tail();
+static void switch_to(struct processor *p, co_context_t *from, struct co *next);
+static void shared_stack_swap(struct processor *p, struct co *next);
+static void processor_init(struct processor *p, int id);
+static void machine_trace_init(struct machine *m);
+static inline void trace_event(int type, struct co *g);
+static void processor_destroy(struct processor *p);
+static void machine_loop();
+static int machine_spin(struct machine *m);
+static void machine_park(struct machine *m);
+static void wake_one();
+static void wake_machine(struct machine *m);
+static void netpoll_wakeup();
+static void netpoll_ready(struct epoll_event *events, int n);
+static int netpoll_poll();
+static void netpoll_park(_Atomic(struct co *) *slot, struct co *g);
+static int uring_flush(struct processor *p);
+static void timer_add(struct processor *p, struct timer *t);
+static int timer_del(struct timer *t);
+static uint64_t timer_deadline(struct processor *p);
+static int timer_due(struct processor *p);
+static void timers_run(struct processor *p);
+static void wait_node_add(struct co *target, struct wait_node *node);
+static void park_cond_init(pthread_cond_t *cond);
+static uint32_t processor_rand(struct processor *p, uint32_t n);
+static struct machine* machine_new(struct processor *p);
+static int processor_start_locked(void *(*start_routine)(void *), void *arg);
+static void machine_stop(struct machine *m);
+static void processor_place(struct processor *p);
+static int machine_bind(struct machine *m, struct processor *p);
+static void sysmon_preempt(uint64_t now, uint64_t slice);
 static void co_wrapper();
-static void dead_queue_push(struct co *g);
-static void cleanup_dead_coroutines();
+static struct co* co_create(const struct co_attr *attr, void (*func)(void *), void *arg, struct processor *p);
+static uint8_t* stack_map(size_t size, int flags);
+static void stack_unmap(uint8_t *stack, size_t size);
+static uint8_t* stack_alloc(struct processor *p, size_t size, int flags);
+static void stack_free(struct processor *p, uint8_t *stack, size_t size, int flags);
+static void stack_cache_clear(uint8_t **cache);
+static struct co* co_alloc(struct processor *p);
+static void co_unref(struct processor *p, struct co *g);
+static void co_destroy(struct co *g);
 
 struct thread_init_data {
   struct machine *m;
@@ -120,411 +475,3281 @@ static void* thread_init_wrapper(void *arg) {
   current_m = m;
   current_p = m->p;
   
-  DEBUG_PRINT("M启动, PID=%d", m->p->id);
+  INFO_PRINT("M启动, PID=%d", m->p ? m->p->id : -1);
   
   if (start_routine) {
     char thread_name[64];
     snprintf(thread_name, sizeof(thread_name), "M-%d", m->p->id);
     
-    DEBUG_PRINT("创建协程执行start_routine: %s", thread_name);
-    
-    struct co *worker_co = malloc(sizeof(struct co));
-    assert(worker_co != NULL);
+    INFO_PRINT("创建协程执行start_routine: %s", thread_name);
     
-    worker_co->name = strdup(thread_name);
-    worker_co->func = (void (*)(void *))start_routine;
-    worker_co->arg = routine_arg;
-    worker_co->status = CO_NEW;
-    list_init(&worker_co->waiters);
-    worker_co->next = NULL;
-    
-    worker_co->stack = (uint8_t *)malloc(STACK_SIZE);
-    assert(worker_co->stack != NULL);
-    
-    getcontext(&worker_co->context);
-    worker_co->context.uc_stack.ss_sp = worker_co->stack;
-    worker_co->context.uc_stack.ss_size = STACK_SIZE;
-    worker_co->context.uc_link = NULL;
-    makecontext(&worker_co->context, co_wrapper, 0);
+    // 没有人等待它, 结束后立即回收控制块
+    struct co_attr attr = { .name = thread_name, .stack_size = 0, .flags = CO_ATTR_DETACHED };
+    struct co *worker_co = co_create(&attr, (void (*)(void *))start_routine, routine_arg, m->p);
 
     local_queue_push(m->p, worker_co);
     m->spinning = 0;
   }
   
   free(init_data);
+  if (m->p) {
+    // 创建时代为计入的自旋数 (见processor_start_locked), machine_spin会重新计入
+    atomic_fetch_sub(&runtime.nr_spinning, 1);
+  }
   
   // 进入machine_loop调度循环，即G0
+  machine_loop();
+  
+  return NULL;
+}
+
+// G0: 没有可运行的协程时切换到这里等待
+static void machine_loop() {
+  schedule_tail();
+
+  struct machine *m = current_m;
   while (1) {
-    if (m->spinning) {
-      usleep(1000); // 1ms
+    if (!m->p) {
+      // 阻塞调用返回时P已经被转交, 或者是新创建的备用M
+      machine_stop(m);
+    } else if (m->spinning) {
+      if (!machine_spin(m)) {
+        machine_park(m);
+      }
       m->spinning = 0;
     } else {
       schedule();
     }
   }
-  
-  return NULL;
 }
 
-__attribute__((constructor))
-static void runtime_init() {
-  if (runtime.initialized) return;
-    
-  DEBUG_PRINT("初始化多核协程Runtime...");
-    
-  runtime.global_queue_head = NULL;
-  runtime.global_queue_tail = NULL;
-  runtime.global_queue_size = 0;
-  pthread_mutex_init(&runtime.global_mutex, NULL);
-    
-  runtime.num_processors = 0;
-  runtime.num_machines = 0;
-  runtime.gomaxprocs = get_nprocs(); // 默认为可用的CPU核数
-  runtime.initialized = 1;
-    
-  runtime.dead_queue_head = NULL;
-  runtime.dead_queue_tail = NULL;
-  runtime.dead_queue_size = 0;
-  pthread_mutex_init(&runtime.dead_mutex, NULL);
-    
-  main_co.name = strdup("main");
-  main_co.func = NULL;
-  main_co.arg = NULL;
-  main_co.status = CO_RUNNING;
-  list_init(&main_co.waiters);
-  main_co.stack = NULL;
-  main_co.next = NULL;
-    
-  main_processor.id = 0;
-  main_processor.private_head = 0;
-  main_processor.private_tail = 0;
-  main_processor.private_size = 0;
-  main_processor.public_head = 0;
-  main_processor.public_tail = 0;
-  main_processor.public_size = 0;
-  pthread_mutex_init(&main_processor.public_mutex, NULL);
-  main_processor.current_g = &main_co;
-  main_processor.m = &main_machine;
-    
-  main_machine.thread = pthread_self();
-  main_machine.p = &main_processor;
-  main_machine.spinning = 0;
-    
-  current_m = &main_machine;
-  current_p = &main_processor;
-    
-  runtime.processors[0] = &main_processor;
-  runtime.machines[0] = &main_machine;
-  runtime.num_processors = 1;
-  runtime.num_machines = 1;
-    
-  srand(time(NULL));
-  DEBUG_PRINT("多核协程Runtime初始化完成, GOMAXPROCS=%d", runtime.gomaxprocs);
+static void machine_trace_init(struct machine *m) {
+#ifdef CO_TRACE
+  trace_ring_init(&m->trace);
+#else
+  atomic_init(&m->trace.head, 0);
+  m->trace.events = NULL;
+#endif
 }
 
-struct co* co_start(const char *name, void (*func)(void *), void *arg) {
-  DEBUG_PRINT("创建新协程: %s", name);
-  struct co *new_co = malloc(sizeof(struct co));
-  assert(new_co != NULL);
-
-  new_co->name = strdup(name);
-  new_co->func = func;
-  new_co->arg = arg;
-  new_co->status = CO_NEW;
-  list_init(&new_co->waiters);
-  new_co->next = NULL;
-
-  new_co->stack = (uint8_t *)malloc(STACK_SIZE);
-  assert(new_co->stack != NULL);
-
-  getcontext(&new_co->context);
-  new_co->context.uc_stack.ss_sp = new_co->stack;
-  new_co->context.uc_stack.ss_size = STACK_SIZE;
-  new_co->context.uc_link = NULL;
-  makecontext(&new_co->context, co_wrapper, 0);
+// 记录当前M上的调度事件; 未定义CO_TRACE时为空操作
+static inline void trace_event(int type, struct co *g) {
+#ifdef CO_TRACE
+  trace_ring_record(&current_m->trace, type, g ? g->id : 0, current_p->id);
+#else
+  (void)type;
+  (void)g;
+#endif
+}
 
-  local_queue_push(current_p, new_co);
-    
-  return new_co;
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
-void co_yield() {
-  if (!current_p || !current_p->current_g) return;
-    
-  DEBUG_PRINT("协程 %s 调用 co_yield", current_p->current_g->name);
-    
-  struct co *current = current_p->current_g;
-    
-  // 如果当前协程仍然可运行，将其重新加入队列
-  if (current->status == CO_RUNNING) {
-    public_queue_push(current_p, current); // 函数内会判断是否需要放入全局队列
-  }
-  schedule();
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __asm__ volatile("pause");
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
 }
 
-void co_wait(struct co *co) {
-  assert(co != NULL);
-  assert(current_p && current_p->current_g);
-  assert(co != current_p->current_g);
-    
-  DEBUG_PRINT("协程 %s 等待协程 %s", current_p->current_g->name, co->name);
-    
-  if (co->status == CO_DEAD) {
-    DEBUG_PRINT("协程 %s 已经结束，无需等待", co->name);
-    return;
+// 是否有p可以运行的协程 (近似值, 只用于决定是否继续休眠)
+static int runtime_has_work(struct processor *p) {
+  if (p->runnext || p->private_size > 0 || atomic_load(&p->shared_queue_size) > 0) {
+    return 1;
   }
-    
-  struct co *current = current_p->current_g;
-  current->status = CO_WAITING;
-  list_add(&co->waiters, current);
-    
-  DEBUG_PRINT("协程 %s 进入等待状态", current->name);
-  schedule();
+  if (p->ring_inflight > 0 && uring_peek_cqe(&p->ring)) {
+    return 1;
+  }
+  if (timer_due(p)) {
+    return 1;
+  }
+  // 超出GOMAXPROCS的P只处理自己的定时器、io_uring和共享栈协程
+  if (processor_retired(p)) {
+    return 0;
+  }
+  if (atomic_load(&runtime.global_queue_size) > 0) {
+    return 1;
+  }
+  for (int i = 0; i < runtime.num_processors; i++) {
+    struct processor *other = runtime.processors[i];
+    if (other && (deque_size(&other->public_queue) > 0 || atomic_load(&other->runnext))) {
+      return 1;
+    }
+  }
+  return 0;
 }
 
-int co_thread(void *(*start_routine)(void *), void *arg) {
-  if (runtime.num_machines >= runtime.gomaxprocs) {
-    DEBUG_PRINT("已达到最大线程数 %d", runtime.gomaxprocs);
-    return -1;
+// 有界自适应自旋: 找到工作时加倍下次的自旋次数, 否则减半
+static int machine_spin(struct machine *m) {
+  atomic_fetch_add(&runtime.nr_spinning, 1);
+  int found = 0;
+  for (int i = 0; i < m->spin_budget && !found; i++) {
+    for (int j = 0; j < SPIN_PAUSE; j++) {
+      cpu_relax();
+    }
+    found = runtime_has_work(m->p);
   }
-    
-  struct machine *m = malloc(sizeof(struct machine));
-  struct processor *p = malloc(sizeof(struct processor));
-  assert(m != NULL && p != NULL);
-    
-  p->id = runtime.num_processors;
-  p->private_head = 0;
-  p->private_tail = 0;
-  p->private_size = 0;
-  p->public_head = 0;
-  p->public_tail = 0;
-  p->public_size = 0;
-  pthread_mutex_init(&p->public_mutex, NULL);
-  p->current_g = NULL;
-  p->m = m;
-    
-  m->p = p;
-  m->spinning = 1;
-    
-  runtime.processors[runtime.num_processors++] = p;
-  runtime.machines[runtime.num_machines++] = m;
-
-  struct thread_init_data *init_data = malloc(sizeof(struct thread_init_data));
-  assert(init_data != NULL);
-  init_data->m = m;
-  init_data->start_routine = start_routine;
-  init_data->arg = arg;
+  atomic_fetch_sub(&runtime.nr_spinning, 1);
 
-  pthread_attr_t attr;
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    
-  int ret = pthread_create(&m->thread, &attr, thread_init_wrapper, init_data);
-  pthread_attr_destroy(&attr);
-    
-  if (ret == 0) {
-    DEBUG_PRINT("创建新线程成功, 处理器ID=%d", p->id);
+  if (found) {
+    m->spin_budget = m->spin_budget * 2 > SPIN_MAX ? SPIN_MAX : m->spin_budget * 2;
+    m->woken = 0;
   } else {
-    free(init_data);
-    free(m);
-    free(p);
-    runtime.num_processors--;
-    runtime.num_machines--;
+    m->spin_budget = m->spin_budget / 2 < SPIN_MIN ? SPIN_MIN : m->spin_budget / 2;
   }
-    
-  return ret;
+  return found;
 }
 
-void co_set_gomaxprocs(int procs) {
-  if (procs > 0 && procs <= 64) {
-    runtime.gomaxprocs = procs;
-    DEBUG_PRINT("设置 GOMAXPROCS=%d", procs);
-  }
+static void idle_mutex_unlock(void *arg) {
+  (void)arg;
+  pthread_mutex_unlock(&runtime.idle_mutex);
 }
 
-int co_get_gomaxprocs() {
-  return runtime.gomaxprocs;
+// 把m从空闲M列表中移除, 调用者持有idle_mutex
+static void idle_list_remove(struct machine *m) {
+  for (int i = 0; i < runtime.num_idle_machines; i++) {
+    if (runtime.idle_machines[i] == m) {
+      runtime.idle_machines[i] = runtime.idle_machines[--runtime.num_idle_machines];
+      break;
+    }
+  }
 }
 
-// ========== 内部调度函数 ==========
+// 加入空闲M列表后再检查一次队列, 与wake_one的"先放入工作再检查nr_idle"配对,
+// 两者之间都有seq_cst屏障, 保证不会出现工作已放入而所有M都在休眠的情况。
+// P上有定时器时最多休眠到最早的定时器到期
+static void machine_park(struct machine *m) {
+  // 日志输出是取消点, 不能在持有idle_mutex时调用
+  DEBUG_PRINT("处理器 %d 没有可运行的协程，准备休眠", m->p->id);
+  pthread_mutex_lock(&runtime.idle_mutex);
+  if (m->woken) {
+    // 上次被唤醒后没有找到工作
+    runtime.spurious_wakeups++;
+    m->woken = 0;
+  }
+  m->parked = 1;
+  runtime.idle_machines[runtime.num_idle_machines++] = m;
+  atomic_fetch_add(&runtime.nr_idle, 1);
+  pthread_mutex_unlock(&runtime.idle_mutex);
 
-static struct co* global_queue_pop() {
-  pthread_mutex_lock(&runtime.global_mutex);
-    
-  if (runtime.global_queue_size == 0) {
-    pthread_mutex_unlock(&runtime.global_mutex);
-    return NULL;
+  atomic_thread_fence(memory_order_seq_cst);
+  int has_work = runtime_has_work(m->p);
+  uint64_t deadline = timer_deadline(m->p);
+
+  pthread_mutex_lock(&runtime.idle_mutex);
+  if (has_work && m->parked) {
+    // 还没有被唤醒, 自己从空闲列表中移除
+    idle_list_remove(m);
+    m->parked = 0;
+    atomic_fetch_sub(&runtime.nr_idle, 1);
+    pthread_mutex_unlock(&runtime.idle_mutex);
+    return;
   }
-  
-  int random_pos = rand() % runtime.global_queue_size;
-  struct co *g = NULL;
-  
-  if (random_pos == 0) {
-    g = runtime.global_queue_head;
-    runtime.global_queue_head = g->next;
-    if (runtime.global_queue_head == NULL) {
-      runtime.global_queue_tail = NULL;
+
+  // 有协程挂起在fd上且没有其它M在等待fd事件时, 由本M阻塞在epoll_wait中,
+  // 仍然计入nr_idle, 唤醒方通过wakefd唤醒
+  if (m->parked && atomic_load(&runtime.netpoll_waiters) > 0 && runtime.netpoll_m == NULL &&
+      !processor_retired(m->p)) {
+    idle_list_remove(m);
+    m->parked = 0;
+    runtime.netpoll_m = m;
+    runtime.parks++;
+    pthread_mutex_unlock(&runtime.idle_mutex);
+
+    int timeout = -1;
+    if (deadline) {
+      uint64_t now = now_ns();
+      timeout = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
     }
-  } else {
-    struct co *prev = runtime.global_queue_head;
-    for (int i = 0; i < random_pos - 1; i++) {
-      prev = prev->next;
+    trace_event(CO_EV_PARK, NULL);
+    struct epoll_event events[POLL_EVENTS];
+    int n = epoll_wait(runtime.epfd, events, POLL_EVENTS, timeout);
+    trace_event(CO_EV_UNPARK, NULL);
+
+    pthread_mutex_lock(&runtime.idle_mutex);
+    runtime.netpoll_m = NULL;
+    atomic_fetch_sub(&runtime.nr_idle, 1);
+    pthread_mutex_unlock(&runtime.idle_mutex);
+
+    netpoll_ready(events, n);
+    return;
+  }
+
+  if (m->parked) {
+    runtime.parks++;
+    trace_event(CO_EV_PARK, NULL);
+    struct timespec ts = { (time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL) };
+    // 退出清理时线程会在pthread_cond_wait中被取消, 需要释放idle_mutex
+    pthread_cleanup_push(idle_mutex_unlock, NULL);
+    while (m->parked) {
+      if (!deadline) {
+        pthread_cond_wait(&m->park_cond, &runtime.idle_mutex);
+      } else if (pthread_cond_timedwait(&m->park_cond, &runtime.idle_mutex, &ts) == ETIMEDOUT && m->parked) {
+        // 定时器到期, 自己离开空闲列表
+        idle_list_remove(m);
+        m->parked = 0;
+        atomic_fetch_sub(&runtime.nr_idle, 1);
+      }
     }
-    
-    g = prev->next;
-    prev->next = g->next;
-    
-    if (g == runtime.global_queue_tail) {
-      runtime.global_queue_tail = prev;
+    pthread_cleanup_pop(0);
+
+    trace_event(CO_EV_UNPARK, NULL);
+    if (m->woken) {
+      uint64_t latency = now_ns() - m->wake_ns;
+      runtime.wake_latency_total_ns += latency;
+      if (latency > runtime.wake_latency_max_ns) {
+        runtime.wake_latency_max_ns = latency;
+      }
     }
   }
-  
-  runtime.global_queue_size--;
-  g->next = NULL;
-    
-  pthread_mutex_unlock(&runtime.global_mutex);
-  return g;
+  pthread_mutex_unlock(&runtime.idle_mutex);
 }
 
-static void global_queue_push(struct co *g) {
-  pthread_mutex_lock(&runtime.global_mutex);
-    
-  g->next = NULL;
-  if (runtime.global_queue_tail) {
-    runtime.global_queue_tail->next = g;
-  } else {
-    runtime.global_queue_head = g;
-  }
-  runtime.global_queue_tail = g;
-  runtime.global_queue_size++;
-    
-  pthread_mutex_unlock(&runtime.global_mutex);
+// 休眠可能带截止时间, 条件变量使用单调时钟
+static void park_cond_init(pthread_cond_t *cond) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(cond, &attr);
+  pthread_condattr_destroy(&attr);
+}
 
-  DEBUG_PRINT("协程 %s 添加到全局队列", g->name);
+// 在idle_mutex保护下唤醒m
+static void machine_unpark_locked(struct machine *m) {
+  idle_list_remove(m);
+  m->parked = 0;
+  m->woken = 1;
+  m->wake_ns = now_ns();
+  atomic_fetch_sub(&runtime.nr_idle, 1);
+  runtime.wakeups++;
+  pthread_cond_signal(&m->park_cond);
 }
 
-static struct co* local_queue_pop(struct processor *p) {
-  if (p->private_size == 0) {
-    move_public_to_private(p);
+// 最近休眠的、P仍在GOMAXPROCS之内的M, 调用者持有idle_mutex
+static struct machine* idle_pick_locked() {
+  for (int i = runtime.num_idle_machines - 1; i >= 0; i--) {
+    if (!processor_retired(runtime.idle_machines[i]->p)) {
+      return runtime.idle_machines[i];
+    }
   }
-  if (p->private_size == 0) {
-    return NULL;
+  return NULL;
+}
+
+// 放入新工作后调用: 没有正在自旋的M时唤醒一个休眠的M; 没有休眠的M且P的数量
+// 还没有达到GOMAXPROCS时启动一个新的工作M
+static void wake_one() {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&runtime.nr_spinning, memory_order_relaxed) > 0) {
+    return;
   }
-  
-  int random_offset = rand() % p->private_size;
-  int random_index = (p->private_head + random_offset) % MAX_LOCAL_QUEUE;
-    
-  struct co *g = p->private_queue[random_index];
-    
-  for (int i = 0; i < p->private_size - random_offset - 1; i++) {
-    int src_index = (random_index + 1 + i) % MAX_LOCAL_QUEUE;
-    int dst_index = (random_index + i) % MAX_LOCAL_QUEUE;
-    p->private_queue[dst_index] = p->private_queue[src_index];
+  if (atomic_load_explicit(&runtime.nr_idle, memory_order_relaxed) == 0 &&
+      runtime.num_processors >= __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED)) {
+    return;
   }
-    
-  p->private_tail = (p->private_tail - 1 + MAX_LOCAL_QUEUE) % MAX_LOCAL_QUEUE;
-  p->private_size--;
-    
-  // 如果这是private队列的最后一个协程，将public队列移动到private队列
-  if (p->private_size == 0) {
-    move_public_to_private(p);
+
+  pthread_mutex_lock(&runtime.idle_mutex);
+  struct machine *m = idle_pick_locked();
+  if (m) {
+    machine_unpark_locked(m);
+  } else if (runtime.netpoll_m) {
+    netpoll_wakeup();
+  } else if (processor_start_locked(NULL, NULL) == 0) {
+    runtime.workers_started++;
   }
-    
-  return g;
+  pthread_mutex_unlock(&runtime.idle_mutex);
 }
 
-static void local_queue_push(struct processor *p, struct co *g) {
-  if (p->private_size >= MAX_LOCAL_QUEUE) {
-    public_queue_push(p, g);
+// 共享栈协程只能由所属P运行, 需要唤醒该P的M
+static void wake_machine(struct machine *m) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&runtime.nr_idle, memory_order_relaxed) == 0) {
     return;
   }
-    
-  p->private_queue[p->private_tail] = g;
-  p->private_tail = (p->private_tail + 1) % MAX_LOCAL_QUEUE;
-  p->private_size++;
-  DEBUG_PRINT("协程 %s 添加到P %d 的private队列", g->name, p->id);
+
+  pthread_mutex_lock(&runtime.idle_mutex);
+  if (m->parked) {
+    machine_unpark_locked(m);
+  } else if (runtime.netpoll_m == m) {
+    netpoll_wakeup();
+  }
+  pthread_mutex_unlock(&runtime.idle_mutex);
 }
 
-// 单个弹出开销太大，不使用
-// static struct co* public_queue_pop(struct processor *p) {
-//   pthread_mutex_lock(&p->public_mutex);
-  
-//   if (p->public_size == 0) {
-//     pthread_mutex_unlock(&p->public_mutex);
-//     return NULL;
-//   }
-  
-//   struct co *g = p->public_queue[p->public_head];
-//   p->public_head = (p->public_head + 1) % MAX_LOCAL_QUEUE;
-//   p->public_size--;
-  
-//   pthread_mutex_unlock(&p->public_mutex);
-//   return g;
-// }
+// ========== CPU亲和性 ==========
 
-static void public_queue_push(struct processor *p, struct co *g) {
-  pthread_mutex_lock(&p->public_mutex);
-  
-  if (p->public_size >= MAX_LOCAL_QUEUE) {
-    pthread_mutex_unlock(&p->public_mutex);
-    global_queue_push(g);
-    return;
+// 解析 /sys 中 "0-3,8-11" 格式的CPU列表, 记录这些CPU属于node
+static void cpulist_parse(const char *s, int node) {
+  while (*s) {
+    char *end;
+    long lo = strtol(s, &end, 10);
+    if (end == s) {
+      break;
+    }
+    long hi = lo;
+    s = end;
+    if (*s == '-') {
+      hi = strtol(s + 1, &end, 10);
+      s = end;
+    }
+    for (long cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+      runtime.cpu_node[cpu] = node;
+    }
+    if (*s != ',') {
+      break;
+    }
+    s++;
+  }
+}
+
+// 读取当前允许的CPU和它们的NUMA节点, 按 (节点, CPU编号) 排序; 没有NUMA信息时都算节点0。
+// 只在第一次开启时读取, 之后主线程已经被绑定, 再读到的掩码只有一个CPU
+static int topology_init() {
+  if (sched_getaffinity(0, sizeof(runtime.cpu_allowed), &runtime.cpu_allowed) != 0) {
+    return -1;
+  }
+  memset(runtime.cpu_node, 0, sizeof(runtime.cpu_node));
+  int max_node = 0;
+  for (int node = 0; node < MAX_NUMA_NODES; node++) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+      continue;
+    }
+    char buf[1024];
+    if (fgets(buf, sizeof(buf), f)) {
+      cpulist_parse(buf, node);
+      max_node = node;
+    }
+    fclose(f);
+  }
+
+  int num_cpus = 0, nodes = 0;
+  for (int node = 0; node <= max_node; node++) {
+    int found = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &runtime.cpu_allowed) && runtime.cpu_node[cpu] == node) {
+        runtime.cpu_order[num_cpus++] = cpu;
+        found = 1;
+      }
+    }
+    nodes += found;
+  }
+  if (num_cpus == 0) {
+    return -1;
+  }
+  runtime.num_cpus = num_cpus;
+  runtime.numa_nodes = nodes;
+  INFO_PRINT("CPU拓扑: %d 个CPU, %d 个NUMA节点", num_cpus, nodes);
+  return 0;
+}
+
+// 按P的id分配CPU, 先占满一个节点再使用下一个; P多于CPU时循环使用。调用者持有idle_mutex
+static void processor_place(struct processor *p) {
+  if (runtime.affinity) {
+    p->cpu = runtime.cpu_order[p->id % runtime.num_cpus];
+    p->node = runtime.cpu_node[p->cpu];
+  } else {
+    p->cpu = -1;
+    p->node = 0;
+  }
+}
+
+// 把取得P的M绑定到P的CPU, 关闭亲和性时恢复开启前的掩码。调用者持有idle_mutex
+static int machine_bind(struct machine *m, struct processor *p) {
+  if (runtime.num_cpus == 0) {
+    return 0;  // 从未开启过
+  }
+  cpu_set_t set;
+  if (runtime.affinity) {
+    CPU_ZERO(&set);
+    CPU_SET(p->cpu, &set);
+  } else {
+    set = runtime.cpu_allowed;
+  }
+  return pthread_setaffinity_np(m->thread, sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+// 已有的P立即重新分配CPU并绑定它们当前的M; 备用M在取得P时绑定
+int co_set_affinity(int enable) {
+  NO_PREEMPT();
+  pthread_mutex_lock(&runtime.idle_mutex);
+  if (enable && runtime.num_cpus == 0 && topology_init() != 0) {
+    pthread_mutex_unlock(&runtime.idle_mutex);
+    return -1;
+  }
+  runtime.affinity = enable ? 1 : 0;
+  int ret = 0;
+  for (int i = 0; i < runtime.num_processors; i++) {
+    struct processor *p = runtime.processors[i];
+    processor_place(p);
+    if (p->m && machine_bind(p->m, p) != 0) {
+      ret = -1;
+    }
+  }
+  pthread_mutex_unlock(&runtime.idle_mutex);
+  return ret;
+}
+
+// ========== 阻塞调用 ==========
+
+// 其它线程检查P是否有需要运行的工作 (近似值)
+static int processor_has_work(struct processor *p) {
+  return p->runnext || p->private_size > 0 || deque_size(&p->public_queue) > 0 ||
+         atomic_load(&p->shared_queue_size) > 0 || p->ring_inflight > 0 || timer_due(p);
+}
+
+// 没有P的M在这里等待sysmon转交P, 取得P后回到调度循环
+static void machine_stop(struct machine *m) {
+  pthread_mutex_lock(&runtime.idle_mutex);
+  runtime.spare_machines[runtime.num_spare_machines++] = m;
+  runtime.spare_spawning = 0;
+  pthread_cleanup_push(idle_mutex_unlock, NULL);
+  while (!m->p) {
+    pthread_cond_wait(&m->park_cond, &runtime.idle_mutex);
+  }
+  pthread_cleanup_pop(0);
+  pthread_mutex_unlock(&runtime.idle_mutex);
+  current_p = m->p;
+  m->spinning = 1;
+  DEBUG_PRINT("备用M取得处理器 %d", m->p->id);
+}
+
+// 创建一个备用M, 它启动后加入备用列表。调用者持有idle_mutex
+static void machine_spawn_spare() {
+  if (runtime.spare_spawning || runtime.num_machines >= MAX_MACHINES) {
+    return;
+  }
+  struct machine *m = machine_new(NULL);
+  struct thread_init_data *init_data = malloc(sizeof(struct thread_init_data));
+  assert(init_data != NULL);
+  init_data->m = m;
+  init_data->start_routine = NULL;
+  init_data->arg = NULL;
+  if (pthread_create(&m->thread, NULL, thread_init_wrapper, init_data) != 0) {
+    free(init_data);
+    pthread_cond_destroy(&m->park_cond);
+    trace_ring_destroy(&m->trace);
+    free(m);
+    return;
+  }
+  runtime.machines[runtime.num_machines++] = m;
+  runtime.spare_spawning = 1;
+}
+
+// 把阻塞调用超过SYSMON_RETAKE_NS且有工作的P转交给备用M; 没有备用M时先创建, 下一轮再转交
+static int sysmon_retake(uint64_t now) {
+  int retaken = 0;
+  for (int i = 0; i < runtime.num_processors; i++) {
+    struct processor *p = runtime.processors[i];
+    struct machine *old = p ? atomic_load(&p->syscall_m) : NULL;
+    if (!old) {
+      continue;
+    }
+    if (now - p->syscall_when < SYSMON_RETAKE_NS || !processor_has_work(p)) {
+      continue;
+    }
+    pthread_mutex_lock(&runtime.idle_mutex);
+    if (runtime.num_spare_machines == 0) {
+      machine_spawn_spare();
+      pthread_mutex_unlock(&runtime.idle_mutex);
+      continue;
+    }
+    if (!atomic_compare_exchange_strong(&p->syscall_m, &old, NULL)) {
+      // 阻塞调用已经返回
+      pthread_mutex_unlock(&runtime.idle_mutex);
+      continue;
+    }
+    struct machine *m = runtime.spare_machines[--runtime.num_spare_machines];
+    p->current_g = NULL;  // 阻塞中的协程不再属于p, 新的M从G0开始调度
+    p->m = m;
+    m->p = p;
+    machine_bind(m, p);
+    runtime.syscall_handoffs++;
+    pthread_cond_signal(&m->park_cond);
+    pthread_mutex_unlock(&runtime.idle_mutex);
+    retaken++;
+  }
+  return retaken;
+}
+
+static void sysmon_mutex_unlock(void *arg) {
+  (void)arg;
+  pthread_mutex_unlock(&runtime.sysmon_mutex);
+}
+
+// 系统监控线程: 有阻塞调用时每20us检查一次, 连续空闲时逐渐放慢到10ms, 之后休眠。
+// 开启异步抢占时不休眠, 检查间隔不超过半个时间片
+static void* sysmon(void *arg) {
+  (void)arg;
+  uint64_t delay = SYSMON_MIN_DELAY_NS;
+  int idle = 0;
+  while (1) {
+    struct timespec ts = { 0, (long)delay };
+    nanosleep(&ts, NULL);
+
+    uint64_t slice = atomic_load(&runtime.preempt_ns);
+    if (atomic_load(&runtime.nr_syscall) == 0 && slice == 0 && delay >= SYSMON_MAX_DELAY_NS) {
+      // 与co_enter_blocking的"先增加nr_syscall再检查sysmon_parked"配对
+      pthread_mutex_lock(&runtime.sysmon_mutex);
+      atomic_store(&runtime.sysmon_parked, 1);
+      pthread_cleanup_push(sysmon_mutex_unlock, NULL);
+      while (atomic_load(&runtime.sysmon_parked) && atomic_load(&runtime.nr_syscall) == 0 &&
+             atomic_load(&runtime.preempt_ns) == 0) {
+        pthread_cond_wait(&runtime.sysmon_cond, &runtime.sysmon_mutex);
+      }
+      pthread_cleanup_pop(0);
+      atomic_store(&runtime.sysmon_parked, 0);
+      pthread_mutex_unlock(&runtime.sysmon_mutex);
+      delay = SYSMON_MIN_DELAY_NS;
+      idle = 0;
+      continue;
+    }
+
+    uint64_t now = now_ns();
+    if (sysmon_retake(now) > 0) {
+      delay = SYSMON_MIN_DELAY_NS;
+      idle = 0;
+    } else if (++idle > 50) {
+      delay = delay * 2 > SYSMON_MAX_DELAY_NS ? SYSMON_MAX_DELAY_NS : delay * 2;
+    }
+    if (slice) {
+      sysmon_preempt(now, slice);
+      if (delay > slice / 2) {
+        delay = slice / 2 < SYSMON_MIN_DELAY_NS ? SYSMON_MIN_DELAY_NS : slice / 2;
+      }
+    }
+  }
+  return NULL;
+}
+
+// 与sysmon的"先设置sysmon_parked再检查条件"配对, 调用者先修改条件
+static void sysmon_wake() {
+  if (atomic_load(&runtime.sysmon_parked)) {
+    pthread_mutex_lock(&runtime.sysmon_mutex);
+    atomic_store(&runtime.sysmon_parked, 0);
+    pthread_cond_signal(&runtime.sysmon_cond);
+    pthread_mutex_unlock(&runtime.sysmon_mutex);
+  }
+}
+
+static void sysmon_start() {
+  pthread_mutex_init(&runtime.sysmon_mutex, NULL);
+  pthread_cond_init(&runtime.sysmon_cond, NULL);
+  if (pthread_create(&runtime.sysmon_thread, NULL, sysmon, NULL) == 0) {
+    runtime.sysmon_started = 1;
+  } else {
+    INFO_PRINT("sysmon启动失败, 阻塞调用期间P不会被转交");
+  }
+}
+
+void co_enter_blocking() {
+  NO_PREEMPT();
+  struct machine *m = current_m;
+  struct processor *p = current_p;
+  if (!p || !p->current_g || m->syscall_g) {
+    return;
+  }
+  struct co *g = p->current_g;
+  if (g->home) {
+    return;  // 共享栈协程运行在P的共享栈上, P不能交给其它M
+  }
+  pthread_once(&runtime.sysmon_once, sysmon_start);
+
+  m->syscall_g = g;
+  p->syscall_when = now_ns();
+  atomic_store(&p->syscall_m, m);
+  atomic_fetch_add(&runtime.nr_syscall, 1);
+  sysmon_wake();
+}
+
+void co_exit_blocking() {
+  NO_PREEMPT();
+  struct machine *m = current_m;
+  if (!m || !m->syscall_g) {
+    return;
+  }
+  struct co *g = m->syscall_g;
+  struct processor *p = m->p;
+  m->syscall_g = NULL;
+  atomic_fetch_sub(&runtime.nr_syscall, 1);
+
+  struct machine *expected = m;
+  if (atomic_compare_exchange_strong(&p->syscall_m, &expected, NULL)) {
+    return;  // P没有被转交, 继续运行
+  }
+
+  // P已经交给其它M: 本协程切换到G0后放入全局队列 (见schedule_tail), 本M成为备用M
+  DEBUG_PRINT("协程 %s 阻塞调用返回时处理器 %d 已被转交", g->name, p->id);
+  m->p = NULL;
+  current_p = NULL;
+  m->exit_g = g;
+  co_context_switch(&g->context, &m->g0);
+  schedule_tail();
+}
+
+// ========== 异步抢占 ==========
+
+// 可执行文件自身代码的范围 (链接器提供), 中断点在libc等共享库中时不抢占
+extern char __executable_start[];
+extern char etext[];
+
+static int preempt_context(void *uctx, uintptr_t *pc, uintptr_t *sp) {
+  ucontext_t *uc = uctx;
+#if defined(__x86_64__)
+  *pc = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+  *sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+  return 1;
+#elif defined(__aarch64__)
+  *pc = (uintptr_t)uc->uc_mcontext.pc;
+  *sp = (uintptr_t)uc->uc_mcontext.sp;
+  return 1;
+#else
+  (void)uc;
+  (void)pc;
+  (void)sp;
+  return 0;
+#endif
+}
+
+// 在信号处理函数中直接切换: 被中断的寄存器由内核保存在协程栈上的信号帧中,
+// 协程再次被调度 (可能在其它M上) 时从这里返回并经sigreturn恢复
+static void preempt_handler(int sig, siginfo_t *info, void *uctx) {
+  (void)sig;
+  (void)info;
+  int saved_errno = errno;
+  struct machine *m = current_m;
+  struct processor *p = current_p;
+  struct co *g = p ? p->current_g : NULL;
+  uintptr_t pc, sp;
+  if (!g || p->m != m || m->syscall_g || g->nopreempt || g->status != CO_RUNNING ||
+      g->home || !g->stack || (g->flags & CO_ATTR_NO_PREEMPT) ||
+      !preempt_context(uctx, &pc, &sp)) {
+    errno = saved_errno;
+    return;
+  }
+  // 只在协程自己的栈上、执行可执行文件中的用户代码时抢占, 并且信号帧之下还要留出调度的栈空间
+  uintptr_t lo = (uintptr_t)g->stack + runtime.page_size;
+  uintptr_t hi = lo + g->stack_size;
+  uintptr_t here = (uintptr_t)&saved_errno;
+  if (pc < (uintptr_t)__executable_start || pc >= (uintptr_t)etext ||
+      sp <= lo || sp > hi || here < lo + PREEMPT_STACK_MIN) {
+    errno = saved_errno;
+    return;
+  }
+
+  g->nopreempt++;  // 调度过程中再次到达的信号不再抢占
+  p->preempts++;
+  DEBUG_PRINT("协程 %s 被抢占", g->name);
+  trace_event(CO_EV_YIELD, g);
+  m->ready_g = g;
+  schedule();
+  if (current_m->ready_g == g) {
+    current_m->ready_g = NULL;
+  }
+  g->nopreempt--;
+  errno = saved_errno;
+}
+
+// sysmon调用: 调度计数超过一个时间片没有变化的P, 向其M发送信号。每个时间片最多发送一次
+static void sysmon_preempt(uint64_t now, uint64_t slice) {
+  for (int i = 0; i < runtime.num_processors; i++) {
+    struct processor *p = runtime.processors[i];
+    if (!p) {
+      continue;
+    }
+    unsigned int tick = __atomic_load_n(&p->schedtick, __ATOMIC_RELAXED);
+    if (tick != p->preempt_tick) {
+      p->preempt_tick = tick;
+      p->preempt_when = now;
+      continue;
+    }
+    if (now - p->preempt_when < slice) {
+      continue;
+    }
+    p->preempt_when = now;
+    // 空闲的M和main协程 (可能阻塞在系统调用中) 不发送, 避免无谓地打断
+    struct co *g = __atomic_load_n(&p->current_g, __ATOMIC_RELAXED);
+    struct machine *m = __atomic_load_n(&p->m, __ATOMIC_RELAXED);
+    if (!g || g == &main_co || !m || atomic_load(&p->syscall_m)) {
+      continue;
+    }
+    pthread_kill(m->thread, PREEMPT_SIGNAL);
+  }
+}
+
+void co_set_preempt(uint64_t ns) {
+  if (ns == 0) {
+    atomic_store(&runtime.preempt_ns, 0);
+    return;
+  }
+  uintptr_t pc, sp;
+  if (!preempt_context(&(ucontext_t){0}, &pc, &sp)) {
+    INFO_PRINT("当前架构不支持异步抢占");
+    return;
+  }
+  if (ns < SYSMON_MIN_DELAY_NS) {
+    ns = SYSMON_MIN_DELAY_NS;
+  }
+  if (!runtime.preempt_installed) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = preempt_handler;
+    // SA_NODEFER: 处理函数可能切换走而不返回, 不能让信号在本线程上一直被屏蔽
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaction(PREEMPT_SIGNAL, &sa, NULL);
+    runtime.preempt_installed = 1;
+  }
+  atomic_store(&runtime.preempt_ns, ns);
+  pthread_once(&runtime.sysmon_once, sysmon_start);
+  sysmon_wake();
+  INFO_PRINT("开启异步抢占, 时间片 %lluns", (unsigned long long)ns);
+}
+
+// ========== 网络轮询 ==========
+
+static void netpoll_init() {
+  runtime.epfd = epoll_create1(EPOLL_CLOEXEC);
+  assert(runtime.epfd >= 0);
+  runtime.wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  assert(runtime.wakefd >= 0);
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  int ret = epoll_ctl(runtime.epfd, EPOLL_CTL_ADD, runtime.wakefd, &ev);
+  assert(ret == 0);
+  (void)ret;
+}
+
+// 唤醒阻塞在epoll_wait中的M
+static void netpoll_wakeup() {
+  uint64_t one = 1;
+  ssize_t ret = write(runtime.wakefd, &one, sizeof(one));
+  (void)ret;
+}
+
+// 取得fd的描述符, 第一次使用时把fd设为非阻塞并以边沿触发注册到epoll
+static struct poll_desc* poll_desc_get(int fd) {
+  pthread_once(&runtime.netpoll_once, netpoll_init);
+  assert(fd >= 0 && fd < POLL_PAGES * POLL_PAGE_SIZE);
+
+  _Atomic(struct poll_desc *) *slot = &runtime.poll_table[fd / POLL_PAGE_SIZE];
+  struct poll_desc *page = atomic_load_explicit(slot, memory_order_acquire);
+  if (!page) {
+    struct poll_desc *fresh = calloc(POLL_PAGE_SIZE, sizeof(struct poll_desc));
+    assert(fresh != NULL);
+    if (atomic_compare_exchange_strong(slot, &page, fresh)) {
+      page = fresh;
+    } else {
+      free(fresh);  // 其它线程已经分配
+    }
+  }
+
+  struct poll_desc *pd = &page[fd % POLL_PAGE_SIZE];
+  int expected = 0;
+  if (atomic_load_explicit(&pd->registered, memory_order_acquire) == 0 &&
+      atomic_compare_exchange_strong(&pd->registered, &expected, 1)) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) {
+      fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = pd };
+    epoll_ctl(runtime.epfd, EPOLL_CTL_ADD, fd, &ev);
+  }
+  return pd;
+}
+
+// fd就绪: 唤醒等待的协程, 没有协程等待时记为POLL_READY
+static void netpoll_unblock(_Atomic(struct co *) *slot) {
+  struct co *old = atomic_load_explicit(slot, memory_order_acquire);
+  while (1) {
+    if (old == POLL_READY) {
+      return;
+    }
+    struct co *new = old ? NULL : POLL_READY;
+    if (atomic_compare_exchange_weak_explicit(slot, &old, new, memory_order_acq_rel, memory_order_acquire)) {
+      break;
+    }
+  }
+  if (old) {
+    atomic_fetch_sub(&runtime.netpoll_waiters, 1);
+    trace_event(CO_EV_READY, old);
+    old->status = CO_RUNNING;
+    co_ready(old);
+  }
+}
+
+// 在当前M上处理epoll返回的事件
+static void netpoll_ready(struct epoll_event *events, int n) {
+  for (int i = 0; i < n; i++) {
+    struct poll_desc *pd = events[i].data.ptr;
+    if (!pd) {
+      uint64_t count;
+      ssize_t ret = read(runtime.wakefd, &count, sizeof(count));
+      (void)ret;
+      continue;
+    }
+    if (pd->ring_owner) {
+      // io_uring请求完成, 只有所属P能收割, 唤醒它的M
+      struct processor *owner = pd->ring_owner;
+      uint64_t count;
+      ssize_t ret = read(owner->ring_efd, &count, sizeof(count));
+      (void)ret;
+      if (owner->m && owner->m != current_m) {
+        wake_machine(owner->m);
+      }
+      continue;
+    }
+    uint32_t ev = events[i].events;
+    if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+      netpoll_unblock(&pd->rg);
+    }
+    if (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+      netpoll_unblock(&pd->wg);
+    }
+  }
+}
+
+// 不阻塞地检查fd事件, 返回事件数
+static int netpoll_poll() {
+  if (atomic_load_explicit(&runtime.netpoll_waiters, memory_order_relaxed) == 0) {
+    return 0;
+  }
+  struct epoll_event events[POLL_EVENTS];
+  int n = epoll_wait(runtime.epfd, events, POLL_EVENTS, 0);
+  if (n > 0) {
+    netpoll_ready(events, n);
+  }
+  return n > 0 ? n : 0;
+}
+
+// 挂起当前协程直到slot对应的fd就绪; 已经就绪时直接返回
+static void netpoll_block(_Atomic(struct co *) *slot) {
+  struct co *ready = POLL_READY;
+  if (atomic_compare_exchange_strong(slot, &ready, NULL)) {
+    return;
+  }
+
+  struct co *current = current_p->current_g;
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  // 与co_wait相同, 切换离开后才登记 (见schedule_tail)
+  current_m->poll_g = current;
+  current_m->poll_slot = slot;
+  schedule();
+}
+
+// 在schedule_tail中登记挂起的协程; 期间fd已经就绪则直接唤醒
+static void netpoll_park(_Atomic(struct co *) *slot, struct co *g) {
+  struct co *old = NULL;
+  atomic_fetch_add(&runtime.netpoll_waiters, 1);
+  if (atomic_compare_exchange_strong_explicit(slot, &old, g, memory_order_acq_rel, memory_order_acquire)) {
+    return;
+  }
+  // 只可能是POLL_READY
+  assert(old == POLL_READY);
+  atomic_fetch_sub(&runtime.netpoll_waiters, 1);
+  atomic_store_explicit(slot, NULL, memory_order_relaxed);
+  g->status = CO_RUNNING;
+  co_ready(g);
+}
+
+// ========== io_uring ==========
+
+static int uring_probe() {
+  if (runtime.uring_supported < 0) {
+    struct uring r;
+    // 需要 IORING_FEAT_RW_CUR_POS (5.6+) 以off=-1使用文件当前位置, 与read/write语义一致
+    runtime.uring_supported = uring_init(&r, 2) == 0 && (r.features & IORING_FEAT_RW_CUR_POS);
+    uring_destroy(&r);
+  }
+  return runtime.uring_supported;
+}
+
+int co_set_io_backend(int backend) {
+  NO_PREEMPT();
+  if (backend == CO_IO_URING && !uring_probe()) {
+    INFO_PRINT("内核不支持io_uring, 使用epoll");
+    backend = CO_IO_EPOLL;
+  }
+  if (backend != CO_IO_URING) {
+    backend = CO_IO_EPOLL;
+  }
+  atomic_store(&runtime.io_backend, backend);
+  return backend;
+}
+
+int co_get_io_backend() {
+  return atomic_load(&runtime.io_backend);
+}
+
+// 创建P的io_uring, 并把完成通知eventfd注册到epoll
+static int uring_setup(struct processor *p) {
+  pthread_once(&runtime.netpoll_once, netpoll_init);
+  if (uring_init(&p->ring, URING_ENTRIES) < 0) {
+    return -1;
+  }
+  p->ring_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (p->ring_efd < 0 || uring_register_eventfd(&p->ring, p->ring_efd) < 0) {
+    if (p->ring_efd >= 0) {
+      close(p->ring_efd);
+      p->ring_efd = -1;
+    }
+    uring_destroy(&p->ring);
+    return -1;
+  }
+  p->ring_pd.ring_owner = p;
+  struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = &p->ring_pd };
+  epoll_ctl(runtime.epfd, EPOLL_CTL_ADD, p->ring_efd, &ev);
+  INFO_PRINT("处理器 %d 创建io_uring", p->id);
+  return 0;
+}
+
+// 取得当前P的一个空闲SQE; 不使用io_uring时返回NULL, 调用者走epoll路径
+static struct io_uring_sqe* uring_sqe_alloc() {
+  if (atomic_load_explicit(&runtime.io_backend, memory_order_relaxed) != CO_IO_URING) {
+    return NULL;
+  }
+  struct processor *p = current_p;
+  // 共享栈协程切换离开后栈会被其它协程覆盖, 内核不能再写入栈上的缓冲区
+  if (!p || !p->current_g || p->current_g->home) {
+    return NULL;
+  }
+  if (p->ring.fd < 0 && uring_setup(p) < 0) {
+    INFO_PRINT("处理器 %d 无法创建io_uring, 回退到epoll", p->id);
+    atomic_store(&runtime.io_backend, CO_IO_EPOLL);
+    return NULL;
+  }
+  struct io_uring_sqe *sqe = uring_get_sqe(&p->ring);
+  if (!sqe) {
+    // 提交队列已满, 先提交已有的请求
+    uring_submit(&p->ring);
+    sqe = uring_get_sqe(&p->ring);
+  }
+  return sqe;
+}
+
+// 挂起当前协程直到sqe完成, 返回CQE的结果 (失败时为负的errno)。
+// sqe在schedule中与本轮其它请求一起提交, 完成后由uring_reap唤醒
+static int uring_wait(struct io_uring_sqe *sqe) {
+  struct processor *p = current_p;
+  struct co *current = p->current_g;
+  struct uring_req req = { current, 0 };
+  sqe->user_data = (uint64_t)(uintptr_t)&req;
+  p->ring_inflight++;
+  atomic_fetch_add(&runtime.netpoll_waiters, 1);
+
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  schedule();
+  return req.res;
+}
+
+// 收割P的完成事件, 返回唤醒的协程数。
+// 在schedule中收割时, 发起请求的协程可能就是还没有切换离开的当前协程,
+// 与co_yield一样交给schedule_tail在切换离开后放回队列
+static int uring_reap(struct processor *p) {
+  int n = 0;
+  struct io_uring_cqe *cqe;
+  while ((cqe = uring_peek_cqe(&p->ring)) != NULL) {
+    struct uring_req *req = (struct uring_req *)(uintptr_t)cqe->user_data;
+    req->res = cqe->res;
+    struct co *g = req->g;
+    uring_cqe_seen(&p->ring);
+    p->ring_inflight--;
+    atomic_fetch_sub(&runtime.netpoll_waiters, 1);
+
+    trace_event(CO_EV_READY, g);
+    g->status = CO_RUNNING;
+    if (g == p->current_g) {
+      p->m->ready_g = g;
+    } else {
+      co_ready(g);
+    }
+    n++;
+  }
+  return n;
+}
+
+// 一次提交本轮积累的SQE, 并收割已完成的请求
+static int uring_flush(struct processor *p) {
+  if (p->ring_inflight == 0) {
+    return 0;
+  }
+  uring_submit(&p->ring);
+  return uring_reap(p);
+}
+
+static ssize_t uring_result(int res) {
+  if (res < 0) {
+    errno = -res;
+    return -1;
+  }
+  return res;
+}
+
+ssize_t co_read(int fd, void *buf, size_t count) {
+  NO_PREEMPT();
+  struct io_uring_sqe *sqe = uring_sqe_alloc();
+  if (sqe) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = count > URING_RW_MAX ? URING_RW_MAX : count;
+    sqe->off = (uint64_t)-1;
+    int res = uring_wait(sqe);
+    if (res != -EAGAIN) {
+      return uring_result(res);
+    }
+    // 已经设为非阻塞的fd, 回退到epoll等待
+  }
+  struct poll_desc *pd = poll_desc_get(fd);
+  while (1) {
+    ssize_t n = read(fd, buf, count);
+    if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return n;
+    }
+    netpoll_block(&pd->rg);
+  }
+}
+
+ssize_t co_write(int fd, const void *buf, size_t count) {
+  NO_PREEMPT();
+  size_t done = 0;
+  struct io_uring_sqe *sqe;
+  while (done < count && (sqe = uring_sqe_alloc()) != NULL) {
+    size_t len = count - done;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)((const char *)buf + done);
+    sqe->len = len > URING_RW_MAX ? URING_RW_MAX : len;
+    sqe->off = (uint64_t)-1;
+    int res = uring_wait(sqe);
+    if (res == -EAGAIN) {
+      break;
+    }
+    if (res < 0) {
+      return uring_result(res);
+    }
+    done += res;
+  }
+  if (done == count) {
+    return done;
+  }
+  struct poll_desc *pd = poll_desc_get(fd);
+  while (done < count) {
+    ssize_t n = write(fd, (const char *)buf + done, count - done);
+    if (n >= 0) {
+      done += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      netpoll_block(&pd->wg);
+    } else {
+      return -1;
+    }
+  }
+  return done;
+}
+
+int co_accept(int fd, struct sockaddr *addr, socklen_t *addrlen) {
+  NO_PREEMPT();
+  struct io_uring_sqe *sqe = uring_sqe_alloc();
+  if (sqe) {
+    // 连接保持阻塞, 之后的读写由内核等待就绪
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->addr2 = (uint64_t)(uintptr_t)addrlen;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    int res = uring_wait(sqe);
+    if (res != -EAGAIN) {
+      return uring_result(res);
+    }
+  }
+  struct poll_desc *pd = poll_desc_get(fd);
+  while (1) {
+    int conn = accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (conn >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return conn;
+    }
+    netpoll_block(&pd->rg);
+  }
+}
+
+int co_connect(int fd, const struct sockaddr *addr, socklen_t addrlen) {
+  NO_PREEMPT();
+  struct io_uring_sqe *sqe = uring_sqe_alloc();
+  if (sqe) {
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->off = addrlen;
+    int res = uring_wait(sqe);
+    if (res != -EINPROGRESS) {
+      return uring_result(res);
+    }
+    // 非阻塞fd: 与epoll路径一样等待可写
+  }
+  struct poll_desc *pd = poll_desc_get(fd);
+  if (!sqe) {
+    if (connect(fd, addr, addrlen) == 0) {
+      return 0;
+    }
+    if (errno != EINPROGRESS) {
+      return -1;
+    }
+  }
+  // 非阻塞connect: 等待可写后检查连接结果
+  int err = 0;
+  socklen_t len = sizeof(err);
+  do {
+    netpoll_block(&pd->wg);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+      return -1;
+    }
+  } while (err == EINPROGRESS);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+int co_close(int fd) {
+  NO_PREEMPT();
+  if (fd >= 0 && fd < POLL_PAGES * POLL_PAGE_SIZE) {
+    struct poll_desc *page = atomic_load_explicit(&runtime.poll_table[fd / POLL_PAGE_SIZE], memory_order_acquire);
+    struct poll_desc *pd = page ? &page[fd % POLL_PAGE_SIZE] : NULL;
+    if (pd && atomic_exchange(&pd->registered, 0)) {
+      epoll_ctl(runtime.epfd, EPOLL_CTL_DEL, fd, NULL);
+      // 唤醒仍在等待的协程, 它们重试时会得到EBADF; 再清除状态供复用该fd的新连接使用
+      netpoll_unblock(&pd->rg);
+      netpoll_unblock(&pd->wg);
+      atomic_store(&pd->rg, NULL);
+      atomic_store(&pd->wg, NULL);
+    }
+  }
+  return close(fd);
+}
+
+// ========== 定时器 ==========
+
+// 到期刻度向上取整, 定时器不会提前触发
+static uint64_t timer_tick(uint64_t ns) {
+  return (ns + (1ULL << TIMER_TICK_SHIFT) - 1) >> TIMER_TICK_SHIFT;
+}
+
+// 第level层中下一次处理slot槽的刻度, 用作该槽内定时器到期时间的下界
+static uint64_t wheel_slot_tick(struct processor *p, int level, int slot) {
+  int shift = TIMER_LEVEL_BITS * level;
+  uint64_t cur = p->wheel_tick >> shift;
+  uint64_t dist = ((slot - (int)(cur & (TIMER_SLOTS - 1)) - 1) & (TIMER_SLOTS - 1)) + 1;
+  return (cur + dist) << shift;
+}
+
+// 下一个需要处理的刻度 (某个非空槽到期或需要降层): 每层取下一个非空槽, O(层数)。
+// 时间轮为空时返回UINT64_MAX
+static uint64_t wheel_next_tick(struct processor *p) {
+  uint64_t next = UINT64_MAX;
+  for (int level = 0; level < TIMER_LEVELS; level++) {
+    uint64_t bits = p->wheel_bitmap[level];
+    if (!bits) {
+      continue;
+    }
+    // 从当前槽的下一个槽开始找第一个非空槽
+    int cur = (int)((p->wheel_tick >> (TIMER_LEVEL_BITS * level)) & (TIMER_SLOTS - 1));
+    int start = (cur + 1) & (TIMER_SLOTS - 1);
+    uint64_t rotated = start ? (bits >> start) | (bits << (TIMER_SLOTS - start)) : bits;
+    int slot = (start + __builtin_ctzll(rotated)) & (TIMER_SLOTS - 1);
+    uint64_t tick = wheel_slot_tick(p, level, slot);
+    if (tick < next) {
+      next = tick;
+    }
+  }
+  return next;
+}
+
+// 按到期刻度与当前刻度的距离选择层, 调用者持有timer_mutex
+static void wheel_insert_locked(struct processor *p, struct timer *t) {
+  uint64_t expires = t->expires > p->wheel_tick ? t->expires : p->wheel_tick + 1;
+  uint64_t delta = expires - p->wheel_tick;
+  int level = 0;
+  while (level < TIMER_LEVELS - 1 && delta >= (1ULL << (TIMER_LEVEL_BITS * (level + 1)))) {
+    level++;
+  }
+  if (delta >= (1ULL << (TIMER_LEVEL_BITS * TIMER_LEVELS))) {
+    // 超出时间轮范围, 先放在最高层最远的槽
+    expires = p->wheel_tick + (1ULL << (TIMER_LEVEL_BITS * TIMER_LEVELS)) - 1;
+  }
+  int slot = (int)((expires >> (TIMER_LEVEL_BITS * level)) & (TIMER_SLOTS - 1));
+
+  t->level = level;
+  t->slot = slot;
+  t->next = p->wheel[level][slot];
+  if (t->next) {
+    t->next->pprev = &t->next;
+  }
+  t->pprev = &p->wheel[level][slot];
+  p->wheel[level][slot] = t;
+  p->wheel_bitmap[level] |= 1ULL << slot;
+}
+
+static void wheel_unlink_locked(struct processor *p, struct timer *t) {
+  *t->pprev = t->next;
+  if (t->next) {
+    t->next->pprev = t->pprev;
+  }
+  if (!p->wheel[t->level][t->slot]) {
+    p->wheel_bitmap[t->level] &= ~(1ULL << t->slot);
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+// 在P的时间轮上启动定时器, t->expires 已设为到期刻度
+static void timer_add(struct processor *p, struct timer *t) {
+  pthread_mutex_lock(&p->timer_mutex);
+  if (atomic_load_explicit(&p->timer_count, memory_order_relaxed) == 0) {
+    // 时间轮为空, 直接跳到当前刻度
+    uint64_t now = now_ns() >> TIMER_TICK_SHIFT;
+    if (now > p->wheel_tick) {
+      p->wheel_tick = now;
+    }
+    atomic_store_explicit(&p->timer_next, UINT64_MAX, memory_order_relaxed);
+  }
+  wheel_insert_locked(p, t);
+  atomic_store_explicit(&t->p, p, memory_order_relaxed);
+  atomic_fetch_add_explicit(&p->timer_count, 1, memory_order_relaxed);
+  uint64_t when = wheel_slot_tick(p, t->level, t->slot) << TIMER_TICK_SHIFT;
+  if (when < atomic_load_explicit(&p->timer_next, memory_order_relaxed)) {
+    atomic_store_explicit(&p->timer_next, when, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&p->timer_mutex);
+}
+
+// 取消定时器, 返回它是否还没有到期。
+// 返回0时到期处理已经完成, 不会再访问定时器和它的等待节点
+static int timer_del(struct timer *t) {
+  struct processor *p = atomic_load_explicit(&t->p, memory_order_acquire);
+  if (!p) {
+    return 0;
+  }
+  pthread_mutex_lock(&p->timer_mutex);
+  int armed = atomic_load_explicit(&t->p, memory_order_relaxed) == p;
+  if (armed) {
+    wheel_unlink_locked(p, t);
+    atomic_store_explicit(&t->p, NULL, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&p->timer_count, 1, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&p->timer_mutex);
+  return armed;
+}
+
+// 最早的定时器到期时间 (ns), 没有定时器时返回0
+static uint64_t timer_deadline(struct processor *p) {
+  if (atomic_load_explicit(&p->timer_count, memory_order_relaxed) == 0) {
+    return 0;
+  }
+  return atomic_load_explicit(&p->timer_next, memory_order_relaxed);
+}
+
+static int timer_due(struct processor *p) {
+  uint64_t deadline = timer_deadline(p);
+  return deadline && now_ns() >= deadline;
+}
+
+static void wait_node_unref(struct wait_node *node) {
+  if (atomic_fetch_sub_explicit(&node->refs, 1, memory_order_acq_rel) == 1) {
+    free(node);
+  }
+}
+
+// 推进时间轮到当前时刻, 唤醒到期定时器的协程。
+// 启动定时器的协程都已经切换离开 (见schedule_tail), 可以直接放回队列
+static void timers_run(struct processor *p) {
+  uint64_t target = now_ns() >> TIMER_TICK_SHIFT;
+  struct co *expired = NULL;
+
+  pthread_mutex_lock(&p->timer_mutex);
+  while (p->wheel_tick < target) {
+    // 跳过中间所有空槽
+    uint64_t tick = wheel_next_tick(p);
+    if (tick > target) {
+      p->wheel_tick = target;
+      break;
+    }
+    p->wheel_tick = tick;
+    // 刻度跨过第level层的边界时, 把该层对应槽里的定时器重新插入到更低的层
+    for (int level = 1; level < TIMER_LEVELS; level++) {
+      if (tick & ((1ULL << (TIMER_LEVEL_BITS * level)) - 1)) {
+        break;
+      }
+      int slot = (int)((tick >> (TIMER_LEVEL_BITS * level)) & (TIMER_SLOTS - 1));
+      struct timer *list = p->wheel[level][slot];
+      p->wheel[level][slot] = NULL;
+      p->wheel_bitmap[level] &= ~(1ULL << slot);
+      while (list) {
+        struct timer *t = list;
+        list = t->next;
+        wheel_insert_locked(p, t);
+      }
+    }
+
+    int slot = (int)(tick & (TIMER_SLOTS - 1));
+    struct timer *list = p->wheel[0][slot];
+    p->wheel[0][slot] = NULL;
+    p->wheel_bitmap[0] &= ~(1ULL << slot);
+    while (list) {
+      struct timer *t = list;
+      list = t->next;
+      t->next = NULL;
+      t->pprev = NULL;
+      if (t->expires > tick) {
+        // 超出时间轮范围的定时器, 还没有到期
+        wheel_insert_locked(p, t);
+        continue;
+      }
+      atomic_fetch_sub_explicit(&p->timer_count, 1, memory_order_relaxed);
+      struct co *g = (struct co *)((char *)t - offsetof(struct co, timer));
+      struct wait_node *node = t->node;
+      int claimed = 1;
+      if (node) {
+        // 与目标协程结束争夺唤醒权
+        claimed = atomic_exchange(&node->g, NULL) != NULL;
+        if (claimed) {
+          node->timed_out = 1;
+        }
+      }
+      // 清除p之后timer_del不再等待, 此后不能再访问node
+      atomic_store_explicit(&t->p, NULL, memory_order_release);
+      if (claimed) {
+        g->next = expired;
+        expired = g;
+      }
+    }
+  }
+  uint64_t next = wheel_next_tick(p);
+  atomic_store_explicit(&p->timer_next, next == UINT64_MAX ? UINT64_MAX : next << TIMER_TICK_SHIFT,
+                        memory_order_relaxed);
+  pthread_mutex_unlock(&p->timer_mutex);
+
+  while (expired) {
+    struct co *g = expired;
+    expired = g->next;
+    g->next = NULL;
+    trace_event(CO_EV_READY, g);
+    g->status = CO_RUNNING;
+    co_ready(g);
+  }
+}
+
+// ========== 同步原语 ==========
+
+#define MUTEX_LOCKED 1
+#define MUTEX_WAITERS 2     // 等待队列不空
+#define MUTEX_STARVING 4    // 有等待者等待超过MUTEX_STARVE_NS, 解锁时直接交给队首
+
+static inline void spin_lock(atomic_int *lock) {
+  while (atomic_exchange_explicit(lock, 1, memory_order_acquire)) {
+    while (atomic_load_explicit(lock, memory_order_relaxed)) {
+      cpu_relax();
+    }
+  }
+}
+
+static inline void spin_unlock(atomic_int *lock) {
+  atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+static void sync_enqueue(struct co **head, struct co **tail, struct co *g, int front) {
+  if (front) {
+    g->next = *head;
+    *head = g;
+    if (!*tail) *tail = g;
+  } else {
+    g->next = NULL;
+    if (*tail) (*tail)->next = g;
+    else *head = g;
+    *tail = g;
+  }
+}
+
+static struct co* sync_dequeue(struct co **head, struct co **tail) {
+  struct co *g = *head;
+  if (g) {
+    *head = g->next;
+    if (!*head) *tail = NULL;
+    g->next = NULL;
+  }
+  return g;
+}
+
+// 持有等待队列的锁挂起当前协程, 切换离开后才调用unlock释放 (见schedule_tail),
+// 否则唤醒方可能在本协程保存上下文之前就把它放回队列
+static void co_park(void (*unlock)(void *), void *arg) {
+  struct co *current = current_p->current_g;
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  current_m->park_unlock = unlock;
+  current_m->park_arg = arg;
+  schedule();
+}
+
+static void park_spin_unlock(void *lock) {
+  spin_unlock(lock);
+}
+
+static void sync_park(atomic_int *lock) {
+  co_park(park_spin_unlock, lock);
+}
+
+static void sync_ready(struct co *g) {
+  trace_event(CO_EV_READY, g);
+  g->status = CO_RUNNING;
+  co_ready_next(g);
+}
+
+void co_mutex_init(struct co_mutex *mu) {
+  memset(mu, 0, sizeof(*mu));
+}
+
+int co_mutex_trylock(struct co_mutex *mu) {
+  NO_PREEMPT();
+  int s = atomic_load_explicit(&mu->state, memory_order_relaxed);
+  while (!(s & (MUTEX_LOCKED | MUTEX_STARVING))) {
+    if (atomic_compare_exchange_weak_explicit(&mu->state, &s, s | MUTEX_LOCKED,
+                                              memory_order_acquire, memory_order_relaxed)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void co_mutex_lock_slow(struct co_mutex *mu) {
+  assert(current_p && current_p->current_g);
+  struct co *current = current_p->current_g;
+
+  // 持有者在其它M上运行时很快会解锁, 先短暂自旋; 已有等待者时直接排队
+  for (int i = 0; i < MUTEX_SPIN; i++) {
+    for (int j = 0; j < SPIN_PAUSE; j++) {
+      cpu_relax();
+    }
+    int s = 0;
+    if (atomic_compare_exchange_strong_explicit(&mu->state, &s, MUTEX_LOCKED,
+                                                memory_order_acquire, memory_order_relaxed)) {
+      return;
+    }
+    if (s != MUTEX_LOCKED) {
+      break;
+    }
+  }
+
+  uint64_t wait_start = 0;
+  while (1) {
+    spin_lock(&mu->lock);
+    int starving = wait_start && now_ns() - wait_start > MUTEX_STARVE_NS;
+    int s = atomic_load_explicit(&mu->state, memory_order_relaxed);
+    int acquired;
+    do {
+      acquired = !(s & MUTEX_LOCKED);
+      int new_state = acquired ? s | MUTEX_LOCKED
+                               : s | MUTEX_WAITERS | (starving ? MUTEX_STARVING : 0);
+      if (atomic_compare_exchange_weak_explicit(&mu->state, &s, new_state,
+                                                memory_order_acquire, memory_order_relaxed)) {
+        break;
+      }
+    } while (1);
+    if (acquired) {
+      spin_unlock(&mu->lock);
+      return;
+    }
+
+    // 被唤醒后又被新来的协程抢先的等待者排在队首, 避免一直排在后面
+    sync_enqueue(&mu->head, &mu->tail, current, wait_start != 0);
+    if (!wait_start) {
+      wait_start = now_ns();
+      mu->contended++;
+    }
+    current->sync_handoff = 0;
+    sync_park(&mu->lock);
+    if (current->sync_handoff) {
+      return;  // 解锁方已经把锁交给本协程
+    }
+  }
+}
+
+void co_mutex_lock(struct co_mutex *mu) {
+  NO_PREEMPT();
+  int s = 0;
+  if (atomic_compare_exchange_strong_explicit(&mu->state, &s, MUTEX_LOCKED,
+                                              memory_order_acquire, memory_order_relaxed)) {
+    return;
+  }
+  co_mutex_lock_slow(mu);
+}
+
+// 有等待者时state只在持有mu->lock时修改, 解锁方不必循环CAS
+static void co_mutex_unlock_slow(struct co_mutex *mu) {
+  spin_lock(&mu->lock);
+  struct co *g = sync_dequeue(&mu->head, &mu->tail);
+  int s = atomic_load_explicit(&mu->state, memory_order_relaxed);
+  assert(s & MUTEX_LOCKED);
+  int empty = mu->head == NULL;
+  int handoff = g && (s & MUTEX_STARVING);
+  if (handoff) {
+    // 饥饿模式: 锁保持LOCKED直接交给队首, 新来的协程无法插队
+    s = empty ? MUTEX_LOCKED : s;
+    g->sync_handoff = 1;
+    mu->handoffs++;
+  } else {
+    s &= ~MUTEX_LOCKED;
+    if (empty) s &= ~(MUTEX_WAITERS | MUTEX_STARVING);
+  }
+  atomic_store_explicit(&mu->state, s, memory_order_release);
+  spin_unlock(&mu->lock);
+  if (g) {
+    sync_ready(g);
+  }
+}
+
+void co_mutex_unlock(struct co_mutex *mu) {
+  NO_PREEMPT();
+  int s = MUTEX_LOCKED;
+  if (atomic_compare_exchange_strong_explicit(&mu->state, &s, 0,
+                                              memory_order_release, memory_order_relaxed)) {
+    return;
+  }
+  co_mutex_unlock_slow(mu);
+}
+
+void co_cond_init(struct co_cond *cond) {
+  memset(cond, 0, sizeof(*cond));
+}
+
+void co_cond_wait(struct co_cond *cond, struct co_mutex *mu) {
+  NO_PREEMPT();
+  assert(current_p && current_p->current_g);
+  struct co *current = current_p->current_g;
+  // 先入队再解锁mu, 解锁后发出的signal不会丢失
+  spin_lock(&cond->lock);
+  sync_enqueue(&cond->head, &cond->tail, current, 0);
+  cond->waits++;
+  co_mutex_unlock(mu);
+  sync_park(&cond->lock);
+  co_mutex_lock(mu);
+}
+
+void co_cond_signal(struct co_cond *cond) {
+  NO_PREEMPT();
+  spin_lock(&cond->lock);
+  struct co *g = sync_dequeue(&cond->head, &cond->tail);
+  spin_unlock(&cond->lock);
+  if (g) {
+    sync_ready(g);
+  }
+}
+
+void co_cond_broadcast(struct co_cond *cond) {
+  NO_PREEMPT();
+  spin_lock(&cond->lock);
+  struct co *g = cond->head;
+  cond->head = cond->tail = NULL;
+  spin_unlock(&cond->lock);
+  while (g) {
+    struct co *next = g->next;
+    g->next = NULL;
+    sync_ready(g);
+    g = next;
+  }
+}
+
+void co_sem_init(struct co_sem *sem, int value) {
+  memset(sem, 0, sizeof(*sem));
+  atomic_init(&sem->count, value);
+}
+
+int co_sem_trywait(struct co_sem *sem) {
+  NO_PREEMPT();
+  int c = atomic_load(&sem->count);
+  while (c > 0) {
+    if (atomic_compare_exchange_weak(&sem->count, &c, c - 1)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// 等待者先增加nwait再检查count, co_sem_post先增加count再检查nwait,
+// 两边至少有一方能看到对方, 不会出现count>0而等待者一直挂起
+void co_sem_wait(struct co_sem *sem) {
+  NO_PREEMPT();
+  if (co_sem_trywait(sem)) {
+    return;
+  }
+  assert(current_p && current_p->current_g);
+  struct co *current = current_p->current_g;
+  spin_lock(&sem->lock);
+  atomic_fetch_add(&sem->nwait, 1);
+  if (co_sem_trywait(sem)) {
+    atomic_fetch_sub(&sem->nwait, 1);
+    spin_unlock(&sem->lock);
+    return;
+  }
+  sync_enqueue(&sem->head, &sem->tail, current, 0);
+  sem->contended++;
+  sync_park(&sem->lock);
+  // 唤醒方已经替本协程取走了一个单位
+}
+
+void co_sem_post(struct co_sem *sem) {
+  NO_PREEMPT();
+  atomic_fetch_add(&sem->count, 1);
+  if (atomic_load(&sem->nwait) == 0) {
+    return;
+  }
+  spin_lock(&sem->lock);
+  struct co *g = NULL;
+  if (sem->head && co_sem_trywait(sem)) {
+    g = sync_dequeue(&sem->head, &sem->tail);
+    atomic_fetch_sub(&sem->nwait, 1);
+  }
+  spin_unlock(&sem->lock);
+  if (g) {
+    sync_ready(g);
+  }
+}
+
+// ========== 通道 ==========
+
+struct select_state;
+
+// 挂起在通道上的发送方/接收方, 位于等待者自己的栈上 (共享栈协程放在堆上, 见chan_park)
+struct chan_waiter {
+  struct co *g;
+  void *elem;                  // 发送方的数据或接收方的缓冲区, 由对方直接拷贝
+  struct chan_waiter *next;
+  struct chan_waiter *prev;
+  struct select_state *sel;    // co_select的等待者共享, 否则为NULL
+  int index;                   // co_select的case下标
+  int linked;                  // 还在通道的等待队列中
+  int success;                 // 1 通过通信唤醒, 0 通道关闭唤醒
+};
+
+struct chan_queue {
+  struct chan_waiter *head;
+  struct chan_waiter *tail;
+};
+
+// co_select挂起时所有case的等待者共享: 唤醒方CAS done争夺唤醒权, 胜出的一方记录winner
+struct select_state {
+  atomic_int done;
+  struct chan_waiter *winner;
+};
+
+struct co_chan {
+  atomic_int lock;
+  size_t elem_size;
+  int cap;
+  int count;
+  int recvx;                   // 下一个接收的槽
+  int sendx;                   // 下一个发送的槽
+  int closed;
+  struct chan_queue recvq;     // 缓冲区为空时才有接收方等待
+  struct chan_queue sendq;     // 缓冲区已满时才有发送方等待
+  char buf[];
+};
+
+struct co_chan* co_chan_new(size_t elem_size, int cap) {
+  NO_PREEMPT();
+  if (cap < 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  struct co_chan *ch = malloc(sizeof(struct co_chan) + elem_size * cap);
+  if (!ch) {
+    return NULL;
+  }
+  memset(ch, 0, sizeof(struct co_chan));
+  ch->elem_size = elem_size;
+  ch->cap = cap;
+  return ch;
+}
+
+void co_chan_free(struct co_chan *ch) {
+  NO_PREEMPT();
+  if (!ch) return;
+  assert(ch->recvq.head == NULL && ch->sendq.head == NULL);
+  free(ch);
+}
+
+static inline void* chan_slot(struct co_chan *ch, int i) {
+  return ch->buf + (size_t)i * ch->elem_size;
+}
+
+static void chan_enqueue(struct chan_queue *q, struct chan_waiter *w) {
+  w->next = NULL;
+  w->prev = q->tail;
+  if (q->tail) q->tail->next = w;
+  else q->head = w;
+  q->tail = w;
+  w->linked = 1;
+}
+
+static void chan_unlink(struct chan_queue *q, struct chan_waiter *w) {
+  if (w->prev) w->prev->next = w->next;
+  else q->head = w->next;
+  if (w->next) w->next->prev = w->prev;
+  else q->tail = w->prev;
+  w->next = w->prev = NULL;
+  w->linked = 0;
+}
+
+// 取出队首可以唤醒的等待者。co_select的等待者可能已经被其它通道唤醒, 直接丢弃,
+// 它醒来后会自己移除其余通道上的等待者
+static struct chan_waiter* chan_dequeue(struct chan_queue *q) {
+  struct chan_waiter *w;
+  while ((w = q->head)) {
+    chan_unlink(q, w);
+    if (w->sel) {
+      int expected = 0;
+      if (!atomic_compare_exchange_strong(&w->sel->done, &expected, 1)) {
+        continue;
+      }
+      w->sel->winner = w;
+    }
+    return w;
+  }
+  return NULL;
+}
+
+// 持有ch->lock时尝试发送, 完成返回1; *wake为需要在解锁后唤醒的接收方
+static int chan_send_locked(struct co_chan *ch, const void *elem, struct co **wake) {
+  struct chan_waiter *w = chan_dequeue(&ch->recvq);
+  if (w) {
+    memcpy(w->elem, elem, ch->elem_size);  // 直接拷贝到接收方的缓冲区
+    w->success = 1;
+    *wake = w->g;
+    return 1;
+  }
+  if (ch->count < ch->cap) {
+    memcpy(chan_slot(ch, ch->sendx), elem, ch->elem_size);
+    ch->sendx = (ch->sendx + 1) % ch->cap;
+    ch->count++;
+    return 1;
+  }
+  return 0;
+}
+
+// 持有ch->lock时尝试接收, 完成返回1; *wake为需要在解锁后唤醒的发送方
+static int chan_recv_locked(struct co_chan *ch, void *elem, struct co **wake) {
+  struct chan_waiter *w = chan_dequeue(&ch->sendq);
+  if (w) {
+    if (ch->cap == 0) {
+      memcpy(elem, w->elem, ch->elem_size);
+    } else {
+      // 缓冲区已满: 取走队首, 发送方的数据放入腾出的槽, 保持FIFO
+      memcpy(elem, chan_slot(ch, ch->recvx), ch->elem_size);
+      memcpy(chan_slot(ch, ch->recvx), w->elem, ch->elem_size);
+      ch->recvx = (ch->recvx + 1) % ch->cap;
+      ch->sendx = ch->recvx;
+    }
+    w->success = 1;
+    *wake = w->g;
+    return 1;
+  }
+  if (ch->count > 0) {
+    memcpy(elem, chan_slot(ch, ch->recvx), ch->elem_size);
+    ch->recvx = (ch->recvx + 1) % ch->cap;
+    ch->count--;
+    return 1;
+  }
+  return 0;
+}
+
+// 持有ch->lock挂起在q上, 返回对方设置的success。共享栈协程切换离开后栈内容会被
+// 其它协程覆盖, 对方不能直接读写它的栈, 等待者和数据改放在堆上
+static int chan_park(struct co_chan *ch, struct chan_queue *q, void *elem) {
+  assert(current_p && current_p->current_g);
+  struct co *current = current_p->current_g;
+  struct chan_waiter local;
+  struct chan_waiter *w = &local;
+  if (current->home) {
+    w = malloc(sizeof(struct chan_waiter) + ch->elem_size);
+    assert(w != NULL);
+    w->elem = w + 1;
+    if (q == &ch->sendq) {
+      memcpy(w->elem, elem, ch->elem_size);
+    }
+  } else {
+    w->elem = elem;
+  }
+  w->g = current;
+  w->sel = NULL;
+  w->success = 0;
+  chan_enqueue(q, w);
+  sync_park(&ch->lock);
+
+  int success = w->success;
+  if (w != &local) {
+    if (q == &ch->recvq) {
+      memcpy(elem, w->elem, ch->elem_size);
+    }
+    free(w);
+  }
+  return success;
+}
+
+int co_chan_send(struct co_chan *ch, const void *elem) {
+  NO_PREEMPT();
+  spin_lock(&ch->lock);
+  if (ch->closed) {
+    spin_unlock(&ch->lock);
+    errno = EPIPE;
+    return -1;
+  }
+  struct co *wake = NULL;
+  if (chan_send_locked(ch, elem, &wake)) {
+    spin_unlock(&ch->lock);
+    if (wake) sync_ready(wake);
+    return 0;
+  }
+  if (!chan_park(ch, &ch->sendq, (void *)elem)) {
+    errno = EPIPE;
+    return -1;
+  }
+  return 0;
+}
+
+int co_chan_recv(struct co_chan *ch, void *elem) {
+  NO_PREEMPT();
+  spin_lock(&ch->lock);
+  struct co *wake = NULL;
+  if (chan_recv_locked(ch, elem, &wake)) {
+    spin_unlock(&ch->lock);
+    if (wake) sync_ready(wake);
+    return 1;
+  }
+  if (ch->closed) {
+    spin_unlock(&ch->lock);
+    memset(elem, 0, ch->elem_size);
+    return 0;
+  }
+  return chan_park(ch, &ch->recvq, elem);
+}
+
+void co_chan_close(struct co_chan *ch) {
+  NO_PREEMPT();
+  struct co *wake = NULL;
+  spin_lock(&ch->lock);
+  if (ch->closed) {
+    spin_unlock(&ch->lock);
+    return;
+  }
+  ch->closed = 1;
+  // 等待者挂起期间g->next不在任何队列中, 用来串起要唤醒的协程
+  struct chan_waiter *w;
+  while ((w = chan_dequeue(&ch->recvq))) {
+    memset(w->elem, 0, ch->elem_size);
+    w->success = 0;
+    w->g->next = wake;
+    wake = w->g;
+  }
+  while ((w = chan_dequeue(&ch->sendq))) {
+    w->success = 0;
+    w->g->next = wake;
+    wake = w->g;
+  }
+  spin_unlock(&ch->lock);
+  while (wake) {
+    struct co *g = wake;
+    wake = g->next;
+    g->next = NULL;
+    sync_ready(g);
+  }
+}
+
+// co_select涉及的通道按地址排序去重, 总是按同一顺序加锁, 不会与其它co_select死锁
+struct select_park {
+  struct select_state sel;
+  struct co_chan *locked[CO_SELECT_MAX];
+  int nlocked;
+  struct chan_waiter w[CO_SELECT_MAX];
+  char bounce[];               // 共享栈协程的数据缓冲区
+};
+
+static void select_lock(struct select_park *sp) {
+  for (int i = 0; i < sp->nlocked; i++) {
+    spin_lock(&sp->locked[i]->lock);
+  }
+}
+
+// 第一把锁释放后协程就可能被唤醒并返回, sp随之失效, 先把要解锁的通道拷贝出来
+static void select_unlock(void *arg) {
+  struct select_park *sp = arg;
+  struct co_chan *locked[CO_SELECT_MAX];
+  int n = sp->nlocked;
+  memcpy(locked, sp->locked, n * sizeof(struct co_chan *));
+  for (int i = n - 1; i >= 0; i--) {
+    spin_unlock(&locked[i]->lock);
+  }
+}
+
+int co_select(struct co_select_case *cases, int n, int block) {
+  NO_PREEMPT();
+  assert(n <= CO_SELECT_MAX);
+  assert(current_p && current_p->current_g);
+  struct co *current = current_p->current_g;
+
+  struct select_park local;
+  struct select_park *sp = &local;
+  sp->nlocked = 0;
+  for (int i = 0; i < n; i++) {
+    struct co_chan *ch = cases[i].chan;
+    if (!ch) continue;
+    int j = sp->nlocked;
+    while (j > 0 && sp->locked[j - 1] > ch) j--;
+    if (j > 0 && sp->locked[j - 1] == ch) continue;
+    memmove(&sp->locked[j + 1], &sp->locked[j], (sp->nlocked - j) * sizeof(struct co_chan *));
+    sp->locked[j] = ch;
+    sp->nlocked++;
+  }
+  if (sp->nlocked == 0) {
+    return -1;
+  }
+
+  // 从随机的case开始检查, 多个case同时就绪时不总是选中前面的
+  select_lock(sp);
+  int start = (int)processor_rand(current_p, n);
+  for (int k = 0; k < n; k++) {
+    int i = (start + k) % n;
+    struct co_select_case *c = &cases[i];
+    struct co_chan *ch = c->chan;
+    if (!ch) continue;
+    struct co *wake = NULL;
+    int done = 0;
+    if (c->op == CO_CHAN_SEND) {
+      if (ch->closed) {
+        c->ok = 0;
+        done = 1;
+      } else if (chan_send_locked(ch, c->elem, &wake)) {
+        c->ok = 1;
+        done = 1;
+      }
+    } else {
+      if (chan_recv_locked(ch, c->elem, &wake)) {
+        c->ok = 1;
+        done = 1;
+      } else if (ch->closed) {
+        memset(c->elem, 0, ch->elem_size);
+        c->ok = 0;
+        done = 1;
+      }
+    }
+    if (done) {
+      select_unlock(sp);
+      if (wake) sync_ready(wake);
+      return i;
+    }
+  }
+  if (!block) {
+    select_unlock(sp);
+    return -1;
+  }
+
+  // 在每个通道上挂一个等待者, 任意一个被唤醒即完成
+  size_t bounce_size = 0;
+  if (current->home) {
+    for (int i = 0; i < n; i++) {
+      if (cases[i].chan) bounce_size += cases[i].chan->elem_size;
+    }
+    sp = malloc(sizeof(struct select_park) + bounce_size);
+    assert(sp != NULL);
+    memcpy(sp->locked, local.locked, local.nlocked * sizeof(struct co_chan *));
+    sp->nlocked = local.nlocked;
+  }
+  atomic_init(&sp->sel.done, 0);
+  sp->sel.winner = NULL;
+  char *bounce = sp->bounce;
+  for (int i = 0; i < n; i++) {
+    struct co_select_case *c = &cases[i];
+    struct co_chan *ch = c->chan;
+    if (!ch) continue;
+    struct chan_waiter *w = &sp->w[i];
+    w->g = current;
+    w->sel = &sp->sel;
+    w->index = i;
+    w->success = 0;
+    if (sp != &local) {
+      w->elem = bounce;
+      bounce += ch->elem_size;
+      if (c->op == CO_CHAN_SEND) {
+        memcpy(w->elem, c->elem, ch->elem_size);
+      }
+    } else {
+      w->elem = c->elem;
+    }
+    chan_enqueue(c->op == CO_CHAN_SEND ? &ch->sendq : &ch->recvq, w);
+  }
+  co_park(select_unlock, sp);
+
+  // 从其它通道上移除还没有被取走的等待者
+  select_lock(sp);
+  for (int i = 0; i < n; i++) {
+    struct co_chan *ch = cases[i].chan;
+    if (ch && sp->w[i].linked) {
+      chan_unlink(cases[i].op == CO_CHAN_SEND ? &ch->sendq : &ch->recvq, &sp->w[i]);
+    }
+  }
+  select_unlock(sp);
+
+  struct chan_waiter *winner = sp->sel.winner;
+  int index = winner->index;
+  cases[index].ok = winner->success;
+  if (sp != &local) {
+    if (cases[index].op == CO_CHAN_RECV) {
+      memcpy(cases[index].elem, winner->elem, cases[index].chan->elem_size);
+    }
+    free(sp);
+  }
+  return index;
+}
+
+__attribute__((constructor))
+static void runtime_init() {
+  if (runtime.initialized) return;
+    
+  INFO_PRINT("初始化多核协程Runtime...");
+    
+  runtime.global_queue_head = NULL;
+  runtime.global_queue_tail = NULL;
+  runtime.global_queue_size = 0;
+  pthread_mutex_init(&runtime.global_mutex, NULL);
+    
+  runtime.num_processors = 0;
+  runtime.num_machines = 0;
+  runtime.gomaxprocs = get_nprocs(); // 默认为可用的CPU核数, 可用 CO_GOMAXPROCS 覆盖
+  const char *procs = getenv("CO_GOMAXPROCS");
+  if (procs && atoi(procs) > 0) {
+    runtime.gomaxprocs = atoi(procs);
+  }
+  if (runtime.gomaxprocs > 64) {
+    runtime.gomaxprocs = 64;
+  }
+  runtime.initialized = 1;
+
+  // CO_SCHED_SEED 固定调度随机数种子, 便于复现调度顺序
+  const char *seed = getenv("CO_SCHED_SEED");
+  if (seed && *seed) {
+    runtime.sched_seed = strtoull(seed, NULL, 0);
+  } else {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    runtime.sched_seed = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+  }
+    
+  runtime.co_pool = NULL;
+  runtime.co_pool_size = 0;
+  runtime.co_slabs = NULL;
+  pthread_mutex_init(&runtime.co_mutex, NULL);
+
+  runtime.stack_pool = NULL;
+  runtime.stack_pool_size = 0;
+  runtime.stack_spills = 0;
+  runtime.stack_refills = 0;
+  pthread_mutex_init(&runtime.stack_mutex, NULL);
+  pthread_mutex_init(&runtime.idle_mutex, NULL);
+  runtime.epfd = -1;
+  runtime.wakefd = -1;
+  runtime.netpoll_once = (pthread_once_t)PTHREAD_ONCE_INIT;
+  runtime.sysmon_once = (pthread_once_t)PTHREAD_ONCE_INIT;
+  runtime.uring_supported = -1;
+  atomic_init(&runtime.io_backend, CO_IO_EPOLL);
+  // CO_IO_BACKEND=uring 选择io_uring后端, 不支持时回退到epoll
+  const char *backend = getenv("CO_IO_BACKEND");
+  if (backend && strcmp(backend, "uring") == 0) {
+    co_set_io_backend(CO_IO_URING);
+  }
+  runtime.numa_nodes = 1;
+  // CO_SCHED_POLICY 选择调度策略, 在创建main_processor之前设置
+  const char *policy = getenv("CO_SCHED_POLICY");
+  if (policy) {
+    static const char *policies[] = { "random", "fifo", "lifo", "priority", "fair" };
+    for (int i = 0; i < 5; i++) {
+      if (strcmp(policy, policies[i]) == 0) {
+        runtime.policy = i;
+      }
+    }
+  }
+  // CO_RUNNEXT=0 关闭runnext, 用于对比
+  const char *runnext = getenv("CO_RUNNEXT");
+  runtime.runnext = !(runnext && strcmp(runnext, "0") == 0);
+  runtime.page_size = sysconf(_SC_PAGESIZE);
+    
+  strcpy(main_co.name, "main");
+  atomic_init(&main_co.refs, 1);  // main协程不会被回收
+  main_co.func = NULL;
+  main_co.arg = NULL;
+  main_co.status = CO_RUNNING;
+  atomic_init(&main_co.waiters, NULL);
+  main_co.wait_next = NULL;
+  main_co.stack = NULL;
+  main_co.stack_size = 0;
+  main_co.flags = 0;
+  main_co.home = NULL;
+  main_co.save_buf = NULL;
+  main_co.save_size = 0;
+  main_co.next = NULL;
+  main_co.id = 1;
+  main_co.weight = CO_WEIGHT_DEFAULT;
+  memset(&main_co.timer, 0, sizeof(main_co.timer));
+  atomic_init(&runtime.next_co_id, 2);
+    
+  processor_init(&main_processor, 0);
+  main_processor.current_g = &main_co;
+  main_processor.m = &main_machine;
+    
+  main_machine.thread = pthread_self();
+  main_machine.p = &main_processor;
+  main_machine.spinning = 0;
+  main_machine.dead_g = NULL;
+  main_machine.shared_next = NULL;
+  main_machine.ready_g = NULL;
+  main_machine.wait_g = NULL;
+  main_machine.wait_target = NULL;
+  main_machine.wait_node = NULL;
+  main_machine.timer_g = NULL;
+  main_machine.poll_g = NULL;
+  main_machine.poll_slot = NULL;
+  park_cond_init(&main_machine.park_cond);
+  main_machine.parked = 0;
+  main_machine.woken = 0;
+  main_machine.spin_budget = SPIN_MIN;
+  machine_trace_init(&main_machine);
+  main_machine.g0_stack = stack_map(STACK_SIZE, 0);
+  co_context_init(&main_machine.g0, main_machine.g0_stack + runtime.page_size, STACK_SIZE, machine_loop);
+    
+  current_m = &main_machine;
+  current_p = &main_processor;
+    
+  runtime.processors[0] = &main_processor;
+  runtime.machines[0] = &main_machine;
+  runtime.num_processors = 1;
+  runtime.num_machines = 1;
+
+  // CO_AFFINITY=1 把每个P的M绑定到一个CPU, 并按NUMA节点分组
+  const char *affinity = getenv("CO_AFFINITY");
+  if (affinity && atoi(affinity) > 0) {
+    co_set_affinity(1);
+  }
+    
+  INFO_PRINT("多核协程Runtime初始化完成, GOMAXPROCS=%d", runtime.gomaxprocs);
+}
+
+struct co* co_start(const char *name, void (*func)(void *), void *arg) {
+  struct co_attr attr = { .name = name, .stack_size = 0, .flags = 0 };
+  return co_start_attr(&attr, func, arg);
+}
+
+struct co* co_start_attr(const struct co_attr *attr, void (*func)(void *), void *arg) {
+  NO_PREEMPT();
+  DEBUG_PRINT("创建新协程: %s", attr->name);
+  struct co *new_co = co_create(attr, func, arg, current_p);
+  trace_event(CO_EV_CREATE, new_co);
+
+  // 只有一个P时放入private队列; 否则放入可以被偷取的public队列, 唤醒或按需启动其它M
+  if (!new_co->home && (__atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED) > 1 || processor_retired(current_p))) {
+    co_ready(new_co);
+  } else {
+    local_queue_push(current_p, new_co);
+  }
+    
+  return new_co;
+}
+
+static struct co* co_create(const struct co_attr *attr, void (*func)(void *), void *arg, struct processor *p) {
+  struct co *new_co = co_alloc(p);
+
+  const char *name = attr->name ? attr->name : "co";
+  size_t len = strnlen(name, CO_NAME_MAX - 1);
+  memcpy(new_co->name, name, len);
+  new_co->name[len] = '\0';
+  atomic_init(&new_co->refs, (attr->flags & CO_ATTR_DETACHED) ? 1 : 2);
+  new_co->func = func;
+  new_co->arg = arg;
+  new_co->status = CO_NEW;
+  atomic_init(&new_co->waiters, NULL);
+  new_co->wait_next = NULL;
+  new_co->next = NULL;
+  new_co->id = atomic_fetch_add(&runtime.next_co_id, 1);
+  memset(&new_co->timer, 0, sizeof(new_co->timer));
+  new_co->nopreempt = 1;  // co_wrapper在调用func前后开关
+  new_co->priority = attr->priority < 0 ? 0 : attr->priority > CO_PRIO_MAX ? CO_PRIO_MAX : attr->priority;
+  new_co->sched_class = attr->sched_class < 0 || attr->sched_class >= CO_CLASS_COUNT ? CO_CLASS_NORMAL : attr->sched_class;
+  new_co->weight = attr->weight <= 0 ? CO_WEIGHT_DEFAULT : attr->weight > CO_WEIGHT_MAX ? CO_WEIGHT_MAX : attr->weight;
+  new_co->vruntime = 0;  // 放入队列时调整到所在类的基准附近
+
+  // 栈大小按页对齐
+  size_t size = attr->stack_size ? attr->stack_size : STACK_SIZE;
+  if (size < STACK_MIN_SIZE) {
+    size = STACK_MIN_SIZE;
+  }
+  size = (size + runtime.page_size - 1) & ~(runtime.page_size - 1);
+
+  new_co->flags = attr->flags;
+  new_co->home = NULL;
+  new_co->save_buf = NULL;
+  new_co->save_size = 0;
+
+#ifdef CO_USE_UCONTEXT
+  // ucontext 无法取得切换时的栈顶, 不支持共享栈
+  new_co->flags &= ~CO_ATTR_SHARED_STACK;
+#endif
+
+  if (new_co->flags & CO_ATTR_SHARED_STACK) {
+    // 上下文在首次换入共享栈时初始化
+    if (p->shared_stack == NULL) {
+      p->shared_stack = stack_map(SHARED_STACK_SIZE, 0);
+    }
+    new_co->home = p;
+    new_co->stack = NULL;
+    new_co->stack_size = 0;
+    return new_co;
+  }
+
+  new_co->stack = stack_alloc(p, size, new_co->flags);
+  new_co->stack_size = size;
+
+  co_context_init(&new_co->context, new_co->stack + runtime.page_size, size, co_wrapper);
+
+  return new_co;
+}
+
+// splitmix64, 把种子和P的id打散成互不相关的xorshift初始状态
+static uint64_t sched_seed_mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static void processor_seed(struct processor *p) {
+  p->rand_state = sched_seed_mix(runtime.sched_seed + (uint64_t)p->id);
+  if (p->rand_state == 0) {
+    p->rand_state = 1;  // xorshift的状态不能为0
+  }
+  p->schedtick = 0;
+  p->runnext_streak = 0;
+}
+
+// xorshift64*, 返回 [0, n) 内的随机数; 每个P有自己的状态, 不需要加锁
+static uint32_t processor_rand(struct processor *p, uint32_t n) {
+  uint64_t x = p->rand_state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  p->rand_state = x;
+  uint32_t r = (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+  return (uint32_t)(((uint64_t)r * n) >> 32);
+}
+
+static void processor_init(struct processor *p, int id) {
+  p->id = id;
+  p->private_head = 0;
+  p->private_tail = 0;
+  p->private_size = 0;
+  memset(p->prio_head, 0, sizeof(p->prio_head));
+  memset(p->prio_tail, 0, sizeof(p->prio_tail));
+  p->prio_bitmap = 0;
+  memset(p->fair, 0, sizeof(p->fair));
+  p->fair_now = 0;
+  p->policy = runtime.policy;
+  p->policy_gen = atomic_load(&runtime.policy_gen);
+  processor_seed(p);
+  deque_init(&p->public_queue, MAX_LOCAL_QUEUE);
+  p->current_g = NULL;
+  p->m = NULL;
+  atomic_init(&p->runnext, NULL);
+  p->runnext_streak = 0;
+  p->stack_cache = NULL;
+  p->stack_cache_size = 0;
+  p->stack_hits = 0;
+  p->stack_misses = 0;
+  p->co_cache = NULL;
+  p->co_cache_size = 0;
+  p->shared_stack = NULL;
+  p->shared_owner = NULL;
+  p->shared_queue_head = NULL;
+  p->shared_queue_tail = NULL;
+  p->shared_queue_size = 0;
+  pthread_mutex_init(&p->shared_mutex, NULL);
+  p->ring.fd = -1;
+  p->ring_inflight = 0;
+  p->ring_efd = -1;
+  memset(&p->ring_pd, 0, sizeof(p->ring_pd));
+  pthread_mutex_init(&p->timer_mutex, NULL);
+  memset(p->wheel, 0, sizeof(p->wheel));
+  memset(p->wheel_bitmap, 0, sizeof(p->wheel_bitmap));
+  p->wheel_tick = now_ns() >> TIMER_TICK_SHIFT;
+  atomic_init(&p->timer_count, 0);
+  atomic_init(&p->timer_next, UINT64_MAX);
+  atomic_init(&p->syscall_m, NULL);
+  p->syscall_when = 0;
+  p->preempt_tick = 0;
+  p->preempt_when = 0;
+  p->preempts = 0;
+  p->steals = 0;
+  p->remote_steals = 0;
+  processor_place(p);
+}
+
+static void processor_destroy(struct processor *p) {
+  deque_destroy(&p->public_queue);
+  pthread_mutex_destroy(&p->shared_mutex);
+  pthread_mutex_destroy(&p->timer_mutex);
+  stack_cache_clear(&p->stack_cache);
+  if (p->shared_stack) {
+    stack_unmap(p->shared_stack, SHARED_STACK_SIZE);
+    p->shared_stack = NULL;
+  }
+  if (p->ring.fd >= 0) {
+    uring_destroy(&p->ring);
+    close(p->ring_efd);
+    p->ring_efd = -1;
+  }
+}
+
+void co_yield() {
+  NO_PREEMPT();
+  if (!current_p || !current_p->current_g) return;
+    
+  DEBUG_PRINT("协程 %s 调用 co_yield", current_p->current_g->name);
+    
+  struct co *current = current_p->current_g;
+  trace_event(CO_EV_YIELD, current);
+    
+  // 如果当前协程仍然可运行，切换离开后将其重新加入队列 (见schedule_tail)
+  // 没有其它可运行的协程时schedule直接返回, 当前协程继续执行
+  if (current->status == CO_RUNNING) {
+    current_m->ready_g = current;
+  }
+  schedule();
+  if (current_m->ready_g == current) {
+    current_m->ready_g = NULL;
+  }
+}
+
+void co_wait(struct co *co) {
+  NO_PREEMPT();
+  assert(co != NULL);
+  assert(current_p && current_p->current_g);
+  assert(co != current_p->current_g);
+  assert(atomic_load_explicit(&co->refs, memory_order_relaxed) > 0);  // 句柄已经co_release
+    
+  DEBUG_PRINT("协程 %s 等待协程 %s", current_p->current_g->name, co->name);
+    
+  if (atomic_load_explicit(&co->waiters, memory_order_acquire) == WAITERS_CLOSED) {
+    DEBUG_PRINT("协程 %s 已经结束，无需等待", co->name);
+    return;
+  }
+    
+  struct co *current = current_p->current_g;
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  // 切换离开后才加入等待列表 (见schedule_tail), 否则co在其它M上结束时
+  // 可能在本协程保存上下文之前就把它唤醒并运行
+  current_m->wait_g = current;
+  current_m->wait_target = co;
+    
+  DEBUG_PRINT("协程 %s 进入等待状态", current->name);
+  schedule();
+}
+
+void co_sleep(uint64_t ns) {
+  NO_PREEMPT();
+  assert(current_p && current_p->current_g);
+  if (ns == 0) {
+    co_yield();
+    return;
+  }
+
+  struct co *current = current_p->current_g;
+  current->timer.expires = timer_tick(now_ns() + ns);
+  current->timer.node = NULL;
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  // 切换离开后才启动定时器 (见schedule_tail)
+  current_m->timer_g = current;
+  schedule();
+}
+
+int co_wait_timeout(struct co *co, uint64_t ns) {
+  NO_PREEMPT();
+  assert(co != NULL);
+  assert(current_p && current_p->current_g);
+  assert(co != current_p->current_g);
+  assert(atomic_load_explicit(&co->refs, memory_order_relaxed) > 0);
+
+  if (atomic_load_explicit(&co->waiters, memory_order_acquire) == WAITERS_CLOSED) {
+    return 0;
+  }
+  if (ns == 0) {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+
+  struct co *current = current_p->current_g;
+  struct wait_node *node = malloc(sizeof(struct wait_node));
+  assert(node != NULL);
+  node->next = NULL;
+  atomic_init(&node->g, current);
+  atomic_init(&node->refs, 2);  // 等待列表和本协程各一个
+  node->timed_out = 0;
+
+  current->timer.expires = timer_tick(now_ns() + ns);
+  current->timer.node = node;
+  trace_event(CO_EV_WAIT, current);
+  current->status = CO_WAITING;
+  current_m->timer_g = current;
+  current_m->wait_g = current;
+  current_m->wait_target = co;
+  current_m->wait_node = node;
+  schedule();
+
+  // 被目标结束唤醒时定时器可能还在时间轮上
+  timer_del(&current->timer);
+  current->timer.node = NULL;
+  int timed_out = node->timed_out;
+  wait_node_unref(node);
+  if (timed_out) {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+  return 0;
+}
+
+int co_thread(void *(*start_routine)(void *), void *arg) {
+  NO_PREEMPT();
+  pthread_mutex_lock(&runtime.idle_mutex);
+  int ret = processor_start_locked(start_routine, arg);
+  pthread_mutex_unlock(&runtime.idle_mutex);
+  if (ret == 0) {
+    INFO_PRINT("创建新线程成功, 处理器数=%d", runtime.num_processors);
+  } else {
+    INFO_PRINT("已达到最大线程数 %d", co_get_gomaxprocs());
+  }
+  return ret;
+}
+
+// 创建新的P和运行它的M, start_routine不为NULL时作为新M上的第一个协程。调用者持有idle_mutex
+static int processor_start_locked(void *(*start_routine)(void *), void *arg) {
+  // 备用M没有P, 只按P的数量限制
+  if (runtime.num_processors >= __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED) ||
+      runtime.num_machines >= MAX_MACHINES) {
+    return -1;
+  }
+    
+  struct processor *p = malloc(sizeof(struct processor));
+  assert(p != NULL);
+  processor_init(p, runtime.num_processors);
+  struct machine *m = machine_new(p);
+  p->m = m;
+
+  struct thread_init_data *init_data = malloc(sizeof(struct thread_init_data));
+  assert(init_data != NULL);
+  init_data->m = m;
+  init_data->start_routine = start_routine;
+  init_data->arg = arg;
+
+  runtime.processors[runtime.num_processors] = p;
+  runtime.num_processors++;
+  runtime.machines[runtime.num_machines++] = m;
+  // 新M开始找工作之前就算作自旋中, 避免wake_one在此期间重复创建
+  atomic_fetch_add(&runtime.nr_spinning, 1);
+
+  // 线程保持joinable, 退出清理时需要等待它真正结束
+  int ret = pthread_create(&m->thread, NULL, thread_init_wrapper, init_data);
+  if (ret != 0) {
+    atomic_fetch_sub(&runtime.nr_spinning, 1);
+    runtime.num_processors--;
+    runtime.processors[runtime.num_processors] = NULL;
+    runtime.num_machines--;
+    free(init_data);
+    pthread_cond_destroy(&m->park_cond);
+    trace_ring_destroy(&m->trace);
+    free(m);
+    processor_destroy(p);
+    free(p);
+    return -1;
+  }
+  machine_bind(m, p);
+  return 0;
+}
+
+// 新M的控制块; p为NULL时是备用M
+static struct machine* machine_new(struct processor *p) {
+  struct machine *m = calloc(1, sizeof(struct machine));
+  assert(m != NULL);
+  m->p = p;
+  m->spinning = 1;
+  park_cond_init(&m->park_cond);
+  m->spin_budget = SPIN_MIN;
+  machine_trace_init(m);
+  return m;
+}
+
+// 缩小时id超出范围的P在下一次调度时把可迁移的协程放入全局队列, 之后只运行共享栈协程、
+// 处理自己的定时器和io_uring请求; 扩大时这些P重新参与调度, 不够的P在有新工作时按需创建
+void co_set_gomaxprocs(int procs) {
+  NO_PREEMPT();
+  if (procs <= 0 || procs > 64) {
+    return;
+  }
+  int old = __atomic_exchange_n(&runtime.gomaxprocs, procs, __ATOMIC_RELAXED);
+  INFO_PRINT("设置 GOMAXPROCS=%d", procs);
+  if (procs > old && atomic_load(&runtime.global_queue_size) > 0) {
+    wake_one();
+  }
+}
+
+int co_get_gomaxprocs() {
+  return __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED);
+}
+
+int co_set_sched_policy(int policy) {
+  NO_PREEMPT();
+  if (policy < CO_SCHED_RANDOM || policy > CO_SCHED_FAIR) {
+    return -1;
+  }
+  runtime.policy = policy;
+  atomic_fetch_add_explicit(&runtime.policy_gen, 1, memory_order_release);
+  // 当前P立即切换, 其它P在下一次调度时切换
+  if (current_p) {
+    current_p->policy_gen = atomic_load(&runtime.policy_gen);
+    processor_set_policy(current_p, policy);
+  }
+  return 0;
+}
+
+int co_set_local_sched_policy(int policy) {
+  NO_PREEMPT();
+  if (policy < CO_SCHED_RANDOM || policy > CO_SCHED_FAIR || !current_p) {
+    return -1;
+  }
+  processor_set_policy(current_p, policy);
+  return 0;
+}
+
+int co_get_sched_policy() {
+  return current_p ? current_p->policy : runtime.policy;
+}
+
+void co_get_sched_stats(struct co_sched_stats *stats) {
+  NO_PREEMPT();
+  pthread_mutex_lock(&runtime.idle_mutex);
+  stats->parks = runtime.parks;
+  stats->wakeups = runtime.wakeups;
+  stats->spurious_wakeups = runtime.spurious_wakeups;
+  stats->wake_latency_avg_ns = runtime.wakeups ? runtime.wake_latency_total_ns / runtime.wakeups : 0;
+  stats->wake_latency_max_ns = runtime.wake_latency_max_ns;
+  stats->syscall_handoffs = runtime.syscall_handoffs;
+  stats->workers_started = runtime.workers_started;
+  pthread_mutex_unlock(&runtime.idle_mutex);
+  stats->preemptions = 0;
+  stats->steals = 0;
+  stats->remote_steals = 0;
+  for (int i = 0; i < runtime.num_processors; i++) {
+    stats->preemptions += runtime.processors[i]->preempts;
+    stats->steals += runtime.processors[i]->steals;
+    stats->remote_steals += runtime.processors[i]->remote_steals;
+  }
+}
+
+void co_get_class_stats(struct co_class_stats *stats) {
+  NO_PREEMPT();
+  memset(stats, 0, sizeof(*stats));
+  for (int i = 0; i < runtime.num_processors; i++) {
+    for (int c = 0; c < CO_CLASS_COUNT; c++) {
+      struct fair_class *fc = &runtime.processors[i]->fair[c];
+      stats->runtime_ns[c] += fc->runtime_ns;
+      stats->runs[c] += fc->runs;
+      stats->starved_runs[c] += fc->starved_runs;
+    }
+  }
+}
+
+size_t co_trace_read(int m, struct co_trace_event *buf, size_t max) {
+  if (m < 0 || m >= runtime.num_machines || !runtime.machines[m]) {
+    return 0;
+  }
+  return trace_ring_read(&runtime.machines[m]->trace, buf, max);
+}
+
+void co_trace_dump(FILE *out) {
+  static const char *names[] = {
+    "create", "run", "yield", "wait", "ready", "exit", "steal", "global", "park", "unpark",
+  };
+  struct co_trace_event *buf = malloc(TRACE_RING_SIZE * sizeof(*buf));
+  assert(buf != NULL);
+  for (int m = 0; m < runtime.num_machines; m++) {
+    size_t n = co_trace_read(m, buf, TRACE_RING_SIZE);
+    for (size_t i = 0; i < n; i++) {
+      fprintf(out, "M%d %llu.%09llu %-6s co=%llu p=%d\n", m,
+              (unsigned long long)(buf[i].ts_ns / 1000000000ULL),
+              (unsigned long long)(buf[i].ts_ns % 1000000000ULL),
+              names[buf[i].type], (unsigned long long)buf[i].co_id, buf[i].p_id);
+    }
+  }
+  free(buf);
+}
+
+void co_set_sched_seed(unsigned long long seed) {
+  NO_PREEMPT();
+  runtime.sched_seed = seed;
+  for (int i = 0; i < runtime.num_processors; i++) {
+    processor_seed(runtime.processors[i]);
+  }
+  INFO_PRINT("设置调度随机数种子 %llu", seed);
+}
+
+void co_get_stack_stats(struct co_stack_stats *stats) {
+  NO_PREEMPT();
+  stats->hits = 0;
+  stats->misses = 0;
+  for (int i = 0; i < runtime.num_processors; i++) {
+    stats->hits += runtime.processors[i]->stack_hits;
+    stats->misses += runtime.processors[i]->stack_misses;
+  }
+  pthread_mutex_lock(&runtime.stack_mutex);
+  stats->spills = runtime.stack_spills;
+  stats->refills = runtime.stack_refills;
+  pthread_mutex_unlock(&runtime.stack_mutex);
+}
+
+// ========== 内部调度函数 ==========
+
+// CO_SCHED_FAIR: 把当前协程从上一次调度到现在的运行时间按权重折算进vruntime, 并记到它的调度类上
+static void fair_account(struct processor *p) {
+  uint64_t now = now_ns();
+  struct co *g = p->current_g;
+  if (g && p->fair_now) {
+    uint64_t delta = now - p->fair_now;
+    g->vruntime += delta * CO_WEIGHT_DEFAULT / g->weight;
+    p->fair[g->sched_class].runtime_ns += delta;
+  }
+  p->fair_now = now;
+}
+
+static void fair_push(struct processor *p, struct co *g) {
+  struct fair_class *fc = &p->fair[g->sched_class];
+  if (fc->size == 0) {
+    fc->since = now_ns();
+  }
+  // 刚创建或等待了很久的协程最多领先FAIR_LAG_NS, 不会独占CPU;
+  // 从其它P迁移来的协程vruntime基准不同, 最多落后FAIR_LAG_NS
+  if (fc->min_vruntime > FAIR_LAG_NS && g->vruntime < fc->min_vruntime - FAIR_LAG_NS) {
+    g->vruntime = fc->min_vruntime - FAIR_LAG_NS;
+  } else if (g->vruntime > fc->min_vruntime + FAIR_LAG_NS) {
+    g->vruntime = fc->min_vruntime + FAIR_LAG_NS;
+  }
+  int i = fc->size++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (fc->heap[parent]->vruntime <= g->vruntime) {
+      break;
+    }
+    fc->heap[i] = fc->heap[parent];
+    i = parent;
+  }
+  fc->heap[i] = g;
+}
+
+static struct co* fair_heap_pop(struct fair_class *fc) {
+  struct co *top = fc->heap[0];
+  struct co *last = fc->heap[--fc->size];
+  int i = 0;
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= fc->size) {
+      break;
+    }
+    if (child + 1 < fc->size && fc->heap[child + 1]->vruntime < fc->heap[child]->vruntime) {
+      child++;
+    }
+    if (last->vruntime <= fc->heap[child]->vruntime) {
+      break;
+    }
+    fc->heap[i] = fc->heap[child];
+    i = child;
+  }
+  if (fc->size > 0) {
+    fc->heap[i] = last;
+  }
+  return top;
+}
+
+// CO_SCHED_FAIR: 本地是否有比cls更高的调度类在等待
+static int fair_higher_waiting(struct processor *p, int cls) {
+  if (cls == CO_CLASS_LATENCY) {
+    return 0;
+  }
+  return p->fair[CO_CLASS_LATENCY].size > 0 ||
+         (cls == CO_CLASS_BACKGROUND && p->fair[CO_CLASS_NORMAL].size > 0);
+}
+
+// CO_SCHED_FAIR: 让出的协程g是否继续运行: 没有更高的类或饿死的类在等待, 且g的vruntime不大于同类中最小的
+static int fair_keep_running(struct processor *p, struct co *g) {
+  if (deque_size(&p->public_queue) > 0 || p->shared_queue_size > 0) {
+    move_public_to_private(p);
+  }
+  if (fair_higher_waiting(p, g->sched_class)) {
+    return 0;
+  }
+  for (int c = 0; c < CO_CLASS_COUNT; c++) {
+    if (c != g->sched_class && p->fair[c].size > 0 && p->fair[c].since + FAIR_STARVE_NS <= p->fair_now) {
+      return 0;
+    }
+  }
+  struct fair_class *fc = &p->fair[g->sched_class];
+  return fc->size == 0 || g->vruntime <= fc->heap[0]->vruntime;
+}
+
+// 选择最高的非空调度类; 较低的类已有FAIR_STARVE_NS没有运行时先运行其中等待最久的一个。
+// 类的数量固定, 选类是O(1), 从类中取出vruntime最小的协程是O(log n)
+static struct co* fair_pop(struct processor *p) {
+  static const int class_order[CO_CLASS_COUNT] = { CO_CLASS_LATENCY, CO_CLASS_NORMAL, CO_CLASS_BACKGROUND };
+  int chosen = -1, starved = -1;
+  for (int i = 0; i < CO_CLASS_COUNT; i++) {
+    struct fair_class *fc = &p->fair[class_order[i]];
+    if (fc->size == 0) {
+      continue;
+    }
+    if (chosen < 0) {
+      chosen = class_order[i];
+    } else if (fc->since + FAIR_STARVE_NS <= p->fair_now &&
+               (starved < 0 || fc->since < p->fair[starved].since)) {
+      starved = class_order[i];
+    }
+  }
+  if (starved >= 0) {
+    chosen = starved;
+    p->fair[chosen].starved_runs++;
+  }
+  struct fair_class *fc = &p->fair[chosen];
+  struct co *g = fair_heap_pop(fc);
+  if (g->vruntime > fc->min_vruntime) {
+    fc->min_vruntime = g->vruntime;
+  }
+  fc->since = p->fair_now;
+  fc->runs++;
+  return g;
+}
+
+// 放入private队列的末尾, 调用者保证没有超出容量
+static void private_push(struct processor *p, struct co *g) {
+  if (p->policy == CO_SCHED_FAIR) {
+    fair_push(p, g);
+  } else if (p->policy == CO_SCHED_PRIORITY) {
+    int level = g->priority;
+    g->next = NULL;
+    if (p->prio_tail[level]) {
+      p->prio_tail[level]->next = g;
+    } else {
+      p->prio_head[level] = g;
+    }
+    p->prio_tail[level] = g;
+    p->prio_bitmap |= 1u << level;
+  } else {
+    p->private_queue[p->private_tail] = g;
+    p->private_tail = (p->private_tail + 1) % MAX_LOCAL_QUEUE;
+  }
+  p->private_size++;
+}
+
+// 放入private队列的队头: CO_SCHED_PRIORITY时同一优先级中最先运行, CO_SCHED_LIFO时最后运行,
+// CO_SCHED_FAIR时仍按vruntime排序
+static void private_push_front(struct processor *p, struct co *g) {
+  if (p->policy == CO_SCHED_FAIR) {
+    fair_push(p, g);
+    p->private_size++;
+    return;
+  }
+  if (p->policy == CO_SCHED_PRIORITY) {
+    int level = g->priority;
+    g->next = p->prio_head[level];
+    if (!p->prio_tail[level]) {
+      p->prio_tail[level] = g;
+    }
+    p->prio_head[level] = g;
+    p->prio_bitmap |= 1u << level;
+  } else {
+    p->private_head = (p->private_head + MAX_LOCAL_QUEUE - 1) % MAX_LOCAL_QUEUE;
+    p->private_queue[p->private_head] = g;
+  }
+  p->private_size++;
+}
+
+// LIFO: 让出或连续运行过多次的协程排到最后。private队列已满时放入全局队列,
+// 放入public队列的话它是最新放入的, 会被立即取回
+static void lifo_defer(struct processor *p, struct co *g) {
+  if (p->private_size < MAX_LOCAL_QUEUE) {
+    private_push_front(p, g);
+  } else {
+    global_queue_push_batch(g, g, 1);
+  }
+}
+
+// 取出队头: 环形数组中最早放入的, 最高优先级中最早放入的, 或编号最小的非空调度类中
+// vruntime最小的 (只用于整体搬移, 不计入统计)。private队列不能为空
+static struct co* private_take(struct processor *p) {
+  struct co *g;
+  if (p->policy == CO_SCHED_FAIR) {
+    int c = 0;
+    while (p->fair[c].size == 0) {
+      c++;
+    }
+    g = fair_heap_pop(&p->fair[c]);
+  } else if (p->policy == CO_SCHED_PRIORITY) {
+    int level = 31 - __builtin_clz(p->prio_bitmap);
+    g = p->prio_head[level];
+    p->prio_head[level] = g->next;
+    if (!g->next) {
+      p->prio_tail[level] = NULL;
+      p->prio_bitmap &= ~(1u << level);
+    }
+    g->next = NULL;
+  } else {
+    g = p->private_queue[p->private_head];
+    p->private_head = (p->private_head + 1) % MAX_LOCAL_QUEUE;
+  }
+  p->private_size--;
+  return g;
+}
+
+// 按P的调度策略从private队列中选出下一个协程, private队列不能为空。
+// CO_SCHED_FAIR是O(log n), 其它策略都是O(1)
+static struct co* private_pop(struct processor *p) {
+  switch (p->policy) {
+  case CO_SCHED_FIFO:
+  case CO_SCHED_PRIORITY:
+    return private_take(p);
+  case CO_SCHED_FAIR:
+    p->private_size--;
+    return fair_pop(p);
+  case CO_SCHED_LIFO:
+    p->private_tail = (p->private_tail + MAX_LOCAL_QUEUE - 1) % MAX_LOCAL_QUEUE;
+    p->private_size--;
+    return p->private_queue[p->private_tail];
+  default: {
+    // 随机选择一个协程, 与队头交换后从队头取出, 不需要移动其余元素
+    int random_offset = processor_rand(p, p->private_size);
+    int random_index = (p->private_head + random_offset) % MAX_LOCAL_QUEUE;
+    struct co *g = p->private_queue[random_index];
+    p->private_queue[random_index] = p->private_queue[p->private_head];
+    p->private_head = (p->private_head + 1) % MAX_LOCAL_QUEUE;
+    p->private_size--;
+    return g;
+  }
+  }
+}
+
+// 切换P的调度策略: 按原来的顺序取出private队列中的所有协程, 再按新策略的存储方式放回
+static void processor_set_policy(struct processor *p, int policy) {
+  if (p->policy == policy) {
+    return;
+  }
+  struct co *head = NULL, *tail = NULL;
+  while (p->private_size > 0) {
+    struct co *g = private_take(p);
+    g->next = NULL;
+    if (tail) {
+      tail->next = g;
+    } else {
+      head = g;
+    }
+    tail = g;
+  }
+  p->policy = policy;
+  p->fair_now = now_ns();  // 切换到CO_SCHED_FAIR时当前协程从现在开始计时
+  p->private_head = 0;
+  p->private_tail = 0;
+  while (head) {
+    struct co *g = head;
+    head = g->next;
+    private_push(p, g);
+  }
+}
+
+// 按FIFO顺序从全局队列头部取一批协程: 返回第一个, 其余放入p的private队列。
+// 每次取 size/P数+1 个, 不超过 max (max <= 0 表示不限) 和本地队列容量的一半,
+// 避免一个P把全局队列搬空。整个过程只加一次锁, 与队列长度无关。
+static struct co* global_queue_pop(struct processor *p, int max) {
+  pthread_mutex_lock(&runtime.global_mutex);
+    
+  if (runtime.global_queue_size == 0) {
+    pthread_mutex_unlock(&runtime.global_mutex);
+    return NULL;
+  }
+  
+  int procs = __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED);
+  if (procs > runtime.num_processors) {
+    procs = runtime.num_processors;
+  }
+  int n = runtime.global_queue_size / procs + 1;
+  if (n > runtime.global_queue_size) {
+    n = runtime.global_queue_size;
+  }
+  if (max > 0 && n > max) {
+    n = max;
+  }
+  if (n > MAX_LOCAL_QUEUE / 2) {
+    n = MAX_LOCAL_QUEUE / 2;
+  }
+  if (n > MAX_LOCAL_QUEUE - p->private_size + 1) {
+    n = MAX_LOCAL_QUEUE - p->private_size + 1;
+  }
+  
+  struct co *g = runtime.global_queue_head;
+  struct co *last = g;
+  for (int i = 1; i < n; i++) {
+    last = last->next;
+  }
+  runtime.global_queue_head = last->next;
+  if (runtime.global_queue_head == NULL) {
+    runtime.global_queue_tail = NULL;
+  }
+  runtime.global_queue_size -= n;
+  last->next = NULL;
+    
+  pthread_mutex_unlock(&runtime.global_mutex);
+
+  struct co *batch = g->next;
+  g->next = NULL;
+  while (batch) {
+    struct co *next = batch->next;
+    batch->next = NULL;
+    private_push(p, batch);
+    batch = next;
+  }
+  return g;
+}
+
+// 把已经用next串好的 [head, tail] 共n个协程一次性放入全局队列, 只加一次锁
+static void global_queue_push_batch(struct co *head, struct co *tail, int n) {
+  pthread_mutex_lock(&runtime.global_mutex);
+
+  tail->next = NULL;
+  if (runtime.global_queue_tail) {
+    runtime.global_queue_tail->next = head;
+  } else {
+    runtime.global_queue_head = head;
+  }
+  runtime.global_queue_tail = tail;
+  runtime.global_queue_size += n;
+
+  pthread_mutex_unlock(&runtime.global_mutex);
+
+  DEBUG_PRINT("%d 个协程批量添加到全局队列", n);
+  wake_one();
+}
+
+static struct co* local_queue_pop(struct processor *p) {
+  if (p->policy == CO_SCHED_LIFO) {
+    // 先取public队列最新放入的一端, 其它P从最早的一端偷取
+    if (p->shared_queue_size > 0) {
+      move_public_to_private(p);
+    }
+    struct co *g = deque_pop(&p->public_queue);
+    if (g) {
+      return g;
+    }
+  }
+  // 按优先级或调度类选择时public队列中新放入的协程也要参与比较
+  if (p->private_size == 0 ||
+      ((p->policy == CO_SCHED_PRIORITY || p->policy == CO_SCHED_FAIR) &&
+       deque_size(&p->public_queue) > 0)) {
+    move_public_to_private(p);
+  }
+  if (p->private_size == 0) {
+    return NULL;
+  }
+  
+  struct co *g = private_pop(p);
+    
+  // 如果这是private队列的最后一个协程，将public队列移动到private队列
+  if (p->private_size == 0) {
+    move_public_to_private(p);
+  }
+    
+  return g;
+}
+
+static void local_queue_push(struct processor *p, struct co *g) {
+  if (p->private_size >= MAX_LOCAL_QUEUE) {
+    if (g->home) {
+      shared_queue_push(g->home, g);
+    } else {
+      public_queue_push(p, g);
+    }
+    return;
+  }
+    
+  private_push(p, g);
+  DEBUG_PRINT("协程 %s 添加到P %d 的private队列", g->name, p->id);
+}
+
+// public队列已满: 把其中较早放入的一半连同g一起批量放入全局队列,
+// 这样每放入 MAX_LOCAL_QUEUE/2 个协程才需要拿一次全局锁
+static void public_queue_push_slow(struct processor *p, struct co *g) {
+  struct co *head = NULL, *tail = NULL;
+  int n = 0;
+  while (n < MAX_LOCAL_QUEUE / 2) {
+    // 所有者也可以从top端取, 与其它窃取者通过CAS竞争
+    struct co *old = deque_steal(&p->public_queue);
+    if (!old) {
+      break;
+    }
+    if (tail) {
+      tail->next = old;
+    } else {
+      head = old;
+    }
+    tail = old;
+    n++;
+  }
+
+  // 被偷走了一部分, 已经有空位
+  if (n < MAX_LOCAL_QUEUE / 2 && deque_push(&p->public_queue, g)) {
+    if (head) {
+      global_queue_push_batch(head, tail, n);
+    }
+    return;
+  }
+
+  if (tail) {
+    tail->next = g;
+  } else {
+    head = g;
+  }
+  global_queue_push_batch(head, g, n + 1);
+}
+
+// 只会由P所在的M调用
+static void public_queue_push(struct processor *p, struct co *g) {
+  if (!deque_push(&p->public_queue, g)) {
+    public_queue_push_slow(p, g);
+    return;
   }
-  
-  p->public_queue[p->public_tail] = g;
-  p->public_tail = (p->public_tail + 1) % MAX_LOCAL_QUEUE;
-  p->public_size++;
-
-  pthread_mutex_unlock(&p->public_mutex);
 
   DEBUG_PRINT("协程 %s 添加到P %d 的public队列", g->name, p->id);
+  wake_one();
+}
+
+// 共享栈协程不能被偷取, 也不能进入全局队列, 唤醒时放入所属P的shared队列
+static void shared_queue_push(struct processor *p, struct co *g) {
+  pthread_mutex_lock(&p->shared_mutex);
+
+  g->next = NULL;
+  if (p->shared_queue_tail) {
+    p->shared_queue_tail->next = g;
+  } else {
+    p->shared_queue_head = g;
+  }
+  p->shared_queue_tail = g;
+  p->shared_queue_size++;
+
+  pthread_mutex_unlock(&p->shared_mutex);
+
+  DEBUG_PRINT("协程 %s 添加到P %d 的shared队列", g->name, p->id);
+  if (p->m) {
+    wake_machine(p->m);
+  }
+}
+
+// 将可运行的协程重新放入队列; 当前P已超出GOMAXPROCS时放入全局队列
+static void co_ready(struct co *g) {
+  if (g->home) {
+    shared_queue_push(g->home, g);
+  } else if (!current_p || processor_retired(current_p)) {
+    global_queue_push_batch(g, g, 1);
+  } else {
+    public_queue_push(current_p, g);
+  }
+}
+
+// 由正在运行的协程唤醒g: 放入当前P的runnext, 当前协程让出或挂起后立即运行, 生产者/消费者
+// 交接的数据还在缓存中。原来的runnext移入public队列, 可以被偷取。唤醒者之后继续计算的话
+// 由空闲M偷取g (见steal_work)。共享栈协程、不在协程中或P已超出GOMAXPROCS时与co_ready相同
+static void co_ready_next(struct co *g) {
+  struct processor *p = current_p;
+  if (!runtime.runnext || g->home || !p || !p->current_g || processor_retired(p)) {
+    co_ready(g);
+    return;
+  }
+  // 其它P只会把runnext从非空改为NULL, 为空时直接写入, 不需要原子交换
+  struct co *old = atomic_load_explicit(&p->runnext, memory_order_relaxed);
+  if (!old) {
+    atomic_store_explicit(&p->runnext, g, memory_order_release);
+  } else {
+    old = atomic_exchange(&p->runnext, g);  // 可能刚被其它P偷走
+  }
+  if (old) {
+    public_queue_push(p, old);  // 其中会唤醒M
+  } else if (atomic_load_explicit(&runtime.nr_spinning, memory_order_relaxed) == 0 &&
+             __atomic_load_n(&runtime.gomaxprocs, __ATOMIC_RELAXED) > 1) {
+    // 唤醒一个M, 当前协程之后一直计算时由它偷取g; 只有一个P时没有M可以偷取
+    wake_one();
+  }
+}
+
+// P已超出GOMAXPROCS: 把本地队列中可以迁移的协程全部放入全局队列, 共享栈协程留在本P
+static void processor_drain(struct processor *p) {
+  struct co *head = NULL, *tail = NULL;
+  int n = 0;
+  struct co *rn = atomic_exchange(&p->runnext, NULL);
+  if (rn) {
+    head = tail = rn;
+    head->next = NULL;
+    n++;
+  }
+  // 共享栈协程先放在一边, 取完后再放回: 立即放回的话按vruntime选择时下一次又会取到它
+  struct co *home_head = NULL, *home_tail = NULL;
+  for (int i = p->private_size; i > 0; i--) {
+    struct co *g = private_take(p);
+    if (g->home) {
+      g->next = NULL;
+      if (home_tail) {
+        home_tail->next = g;
+      } else {
+        home_head = g;
+      }
+      home_tail = g;
+      continue;
+    }
+    g->next = NULL;
+    if (tail) {
+      tail->next = g;
+    } else {
+      head = g;
+    }
+    tail = g;
+    n++;
+  }
+  while (home_head) {
+    struct co *g = home_head;
+    home_head = g->next;
+    private_push(p, g);
+  }
+  struct co *g;
+  while ((g = deque_pop(&p->public_queue)) != NULL) {
+    g->next = NULL;
+    if (tail) {
+      tail->next = g;
+    } else {
+      head = g;
+    }
+    tail = g;
+    n++;
+  }
+  if (n > 0) {
+    DEBUG_PRINT("处理器 %d 超出GOMAXPROCS, %d 个协程移入全局队列", p->id, n);
+    global_queue_push_batch(head, tail, n);
+  }
 }
 
 static void move_public_to_private(struct processor *p) {
-  pthread_mutex_lock(&p->public_mutex);
-  
-  while (p->public_size > 0 && p->private_size < MAX_LOCAL_QUEUE) {
-    struct co *g = p->public_queue[p->public_head];
-    p->public_head = (p->public_head + 1) % MAX_LOCAL_QUEUE;
-    p->public_size--;
+  if (p->shared_queue_size > 0) {
+    pthread_mutex_lock(&p->shared_mutex);
+    while (p->shared_queue_head && p->private_size < MAX_LOCAL_QUEUE) {
+      struct co *g = p->shared_queue_head;
+      p->shared_queue_head = g->next;
+      if (p->shared_queue_head == NULL) {
+        p->shared_queue_tail = NULL;
+      }
+      p->shared_queue_size--;
+      g->next = NULL;
+
+      private_push(p, g);
+    }
+    pthread_mutex_unlock(&p->shared_mutex);
+  }
+
+  // LIFO直接从public队列取; FIFO从最早的一端取, 保持放入的顺序
+  if (p->policy == CO_SCHED_LIFO) {
+    return;
+  }
+  while (p->private_size < MAX_LOCAL_QUEUE) {
+    struct co *g = p->policy == CO_SCHED_FIFO ? deque_steal(&p->public_queue)
+                                              : deque_pop(&p->public_queue);
+    if (!g) {
+      break;
+    }
     
-    p->private_queue[p->private_tail] = g;
-    p->private_tail = (p->private_tail + 1) % MAX_LOCAL_QUEUE;
-    p->private_size++;
+    private_push(p, g);
   }
-  
-  pthread_mutex_unlock(&p->public_mutex);
 }
 
 static struct co* steal_work(struct processor *p) {
-  int start = rand() % runtime.num_processors;
+  // P按NUMA节点分组时先只偷同一节点上的P, 都没有可偷的再跨节点
+  int passes = runtime.affinity && runtime.numa_nodes > 1 ? 2 : 1;
+  for (int pass = 0; pass < passes; pass++) {
+    int start = processor_rand(p, runtime.num_processors);
+    for (int attempts = 0; attempts < runtime.num_processors; attempts++) {
+      int target_id = (start + attempts) % runtime.num_processors;
+      if (target_id == p->id) continue;
+
+      struct processor *target_p = runtime.processors[target_id];
+      if (!target_p) continue;
+      if (passes > 1 && (target_p->node == p->node) != (pass == 0)) continue;
+
+      // 偷取目标public队列的一半 (至少一个), 给目标P留下局部性
+      long want = (deque_size(&target_p->public_queue) + 1) / 2;
+      int stolen = 0;
+      while (stolen < want && p->private_size < MAX_LOCAL_QUEUE) {
+        struct co *g = deque_steal(&target_p->public_queue);
+        if (!g) {
+          break;
+        }
+        local_queue_push(p, g);
+        stolen++;
+      }
+
+      if (stolen == 0) {
+        continue;
+      }
+
+      p->steals++;
+      if (target_p->node != p->node) {
+        p->remote_steals++;
+      }
+      return local_queue_pop(p);
+    }
+  }
+
+  // 最后偷取其它P的runnext。目标P正在运行协程时先等RUNNEXT_STEAL_US: 唤醒者马上挂起的话
+  // (通道交接等) 它由目标P直接运行, 只有唤醒者之后一直计算时才被偷走
+  int slept = 0;
+  int start = processor_rand(p, runtime.num_processors);
   for (int attempts = 0; attempts < runtime.num_processors; attempts++) {
-    int target_id = (start + attempts) % runtime.num_processors;
-    if (target_id == p->id) continue;
-    
-    struct processor *target_p = runtime.processors[target_id];
-    if (!target_p) continue;
-    
-    pthread_mutex_lock(&target_p->public_mutex);
-    
-    if (target_p->public_size == 0) {
-      pthread_mutex_unlock(&target_p->public_mutex);
-      continue;
+    struct processor *target_p = runtime.processors[(start + attempts) % runtime.num_processors];
+    if (!target_p || target_p == p) continue;
+    struct co *g = atomic_load(&target_p->runnext);
+    if (!g) continue;
+    if (!slept && __atomic_load_n(&target_p->current_g, __ATOMIC_RELAXED)) {
+      usleep(RUNNEXT_STEAL_US);
+      slept = 1;
+      g = atomic_load(&target_p->runnext);
     }
-    
-    for (int i = 0; i < target_p->public_size; i++) {
-      struct co *g = target_p->public_queue[target_p->public_head];
-      target_p->public_head = (target_p->public_head + 1) % MAX_LOCAL_QUEUE;
-      target_p->public_size--;
-      
-      local_queue_push(p, g);
+    if (g && atomic_compare_exchange_strong(&target_p->runnext, &g, NULL)) {
+      p->steals++;
+      if (target_p->node != p->node) {
+        p->remote_steals++;
+      }
+      return g;
     }
-
-    pthread_mutex_unlock(&target_p->public_mutex);
-
-    return local_queue_pop(p);
   }
-  
+
   return NULL;
 }
 
@@ -534,188 +3759,656 @@ static void schedule() {
 
   struct co *next = NULL;
 
-  // 1. 从本地队列获取
-  next = local_queue_pop(p);
-    
-  // 2. 偷取
+  // co_set_sched_policy修改了策略, 在这里切换本P的队列
+  unsigned int policy_gen = atomic_load_explicit(&runtime.policy_gen, memory_order_acquire);
+  if (p->policy_gen != policy_gen) {
+    p->policy_gen = policy_gen;
+    processor_set_policy(p, runtime.policy);
+  }
+
+  // 到期的定时器先放回队列
+  if (timer_due(p)) {
+    timers_run(p);
+  }
+
+  // 超出GOMAXPROCS的P交出本地队列, 不再偷取或从全局队列获取
+  int retired = processor_retired(p);
+  if (retired) {
+    processor_drain(p);
+  }
+
+  if (p->policy == CO_SCHED_FAIR) {
+    fair_account(p);
+  }
+
+  // 0. 每调度 GLOBAL_QUEUE_CHECK_INTERVAL 次先检查一次全局队列,
+  //    防止本地队列中的协程互相yield时全局队列中的协程被饿死
+  p->schedtick++;
+  if (!retired && p->schedtick % GLOBAL_QUEUE_CHECK_INTERVAL == 0) {
+    // 所有M都忙时没有M阻塞在epoll_wait中, 定期检查fd事件
+    if (runtime.netpoll_m == NULL) {
+      netpoll_poll();
+    }
+    // 本地队列一直不空时也定期提交积累的io_uring请求
+    uring_flush(p);
+    next = global_queue_pop(p, 1);
+    if (next) {
+      trace_event(CO_EV_GLOBAL, next);
+      DEBUG_PRINT("处理器 %d 定期从全局队列获取协程 %s", p->id, next->name);
+    }
+  }
+
+  // 1. 先运行刚被唤醒的runnext; 连续RUNNEXT_MAX次后放回本地队列, 互相唤醒的一对协程
+  //    不会饿死本地队列中的其它协程。按优先级选择时runnext只排在同一优先级的最前面,
+  //    按调度类选择时有更高的类在等待就放回队列
+  struct co *handoff = NULL;
+  struct co *g = next || !atomic_load_explicit(&p->runnext, memory_order_relaxed) ? NULL
+                 : atomic_exchange(&p->runnext, NULL);  // 可能刚被其它P偷走
+  if (g) {
+    if (p->runnext_streak >= RUNNEXT_MAX) {
+      if (p->policy == CO_SCHED_LIFO) {
+        lifo_defer(p, g);
+      } else {
+        local_queue_push(p, g);
+      }
+    } else if (p->policy == CO_SCHED_PRIORITY && p->private_size < MAX_LOCAL_QUEUE) {
+      private_push_front(p, g);
+      handoff = g;
+    } else if (p->policy == CO_SCHED_FAIR && fair_higher_waiting(p, g->sched_class)) {
+      local_queue_push(p, g);
+    } else {
+      next = handoff = g;
+    }
+  }
+
+  // CO_SCHED_FAIR: 让出的协程切换之后才放回队列, 只比较队列中的协程的话同类的协程只会交替运行,
+  // 权重不起作用。它的vruntime仍是同类中最小的时继续运行
+  if (!next && p->policy == CO_SCHED_FAIR && p->current_g && p->m->ready_g == p->current_g &&
+      !retired && fair_keep_running(p, p->current_g)) {
+    next = p->current_g;
+    p->m->ready_g = NULL;
+  }
+
+  // 2. 从本地队列获取; 本地队列已空时一次提交本轮积累的io_uring请求, 并收割完成的请求
   if (!next) {
+    next = local_queue_pop(p);
+  }
+  p->runnext_streak = next && next == handoff ? p->runnext_streak + 1 : 0;
+  if (!next && uring_flush(p) > 0) {
+    next = local_queue_pop(p);
+  }
+    
+  // 3. 偷取
+  if (!next && !retired) {
     next = steal_work(p);
     if (next) {
+      trace_event(CO_EV_STEAL, next);
       DEBUG_PRINT("处理器 %d 通过work stealing获取协程 %s", p->id, next->name);
     }
   }
     
-  // 3. 从全局队列获取
-  if (!next) {
-    next = global_queue_pop();
+  // 4. 从全局队列获取
+  if (!next && !retired) {
+    next = global_queue_pop(p, 0);
     if (next) {
+      trace_event(CO_EV_GLOBAL, next);
       DEBUG_PRINT("处理器 %d 从全局队列获取协程 %s", p->id, next->name);
     }
   }
+
+  // 5. 检查fd事件, 就绪的协程被放入本P的队列
+  if (!next && !retired && netpoll_poll() > 0) {
+    next = local_queue_pop(p);
+  }
   
-  // 4. 如果还是没有工作，进入自旋
+  struct co *prev = p->current_g;
+
+  // 6. 如果还是没有工作: 当前协程仍可运行则继续执行, 否则回到G0自旋
   if (!next) {
+    if (prev && prev->status == CO_RUNNING && retired && !prev->home) {
+      // 当前协程也要离开这个P, 切换到G0后放入全局队列
+      p->m->ready_g = prev;
+    } else if (prev && prev->status == CO_RUNNING) {
+      // 可能是刚被uring_reap唤醒的当前协程, 不再需要放回队列
+      if (p->m->ready_g == prev) {
+        p->m->ready_g = NULL;
+      }
+      return;
+    }
     p->m->spinning = 1;
     DEBUG_PRINT("处理器 %d 没有可运行的协程，进入自旋", p->id);
+    if (prev) {
+      p->current_g = NULL;
+      co_context_switch(&prev->context, &p->m->g0);
+      schedule_tail();
+    }
     return;
   }
     
   p->m->spinning = 0;
+  p->m->woken = 0;
     
   if (next->status == CO_NEW) {
     next->status = CO_RUNNING;
     DEBUG_PRINT("首次启动协程 %s", next->name);
   }
   
-  struct co *prev = p->current_g;
   p->current_g = next;
+  if (prev != next) {
+    trace_event(CO_EV_RUN, next);
+  }
     
   if (prev && prev != next) {
     DEBUG_PRINT("从协程 %s 切换到协程 %s", prev->name, next->name);
-    swapcontext(&prev->context, &next->context);
+    switch_to(p, &prev->context, next);
+    schedule_tail();
   } else if (!prev) {
     DEBUG_PRINT("启动协程 %s", next->name);
-    setcontext(&next->context);
+    switch_to(p, &p->m->g0, next);
+    schedule_tail();
+  }
+}
+
+// 切换到next。next使用共享栈且栈上是其它协程时, 不能在共享栈上完成换出/换入, 经由G0进行
+static void switch_to(struct processor *p, co_context_t *from, struct co *next) {
+  if (next->home && p->shared_owner != next) {
+    if (from == &p->m->g0) {
+      shared_stack_swap(p, next);
+    } else {
+      p->m->shared_next = next;
+      co_context_switch(from, &p->m->g0);
+      return;
+    }
+  }
+  co_context_switch(from, &next->context);
+}
+
+// 在G0上执行: 将共享栈当前占用者的已用部分拷贝到其save_buf, 再换入next
+static void shared_stack_swap(struct processor *p, struct co *next) {
+#ifndef CO_USE_UCONTEXT
+  uint8_t *top = p->shared_stack + runtime.page_size + SHARED_STACK_SIZE;
+  struct co *owner = p->shared_owner;
+
+  if (owner) {
+    size_t used = top - (uint8_t *)owner->context.sp;
+    // save_buf 按实际使用量分配, 使用量明显缩小时也随之缩小
+    if (owner->save_buf == NULL || used > owner->save_size || used < owner->save_size / 2) {
+      free(owner->save_buf);
+      owner->save_buf = malloc(used);
+      assert(owner->save_buf != NULL);
+    }
+    memcpy(owner->save_buf, owner->context.sp, used);
+    owner->save_size = used;
+  }
+
+  if (next->save_buf) {
+    memcpy(top - next->save_size, next->save_buf, next->save_size);
+  } else {
+    co_context_init(&next->context, p->shared_stack + runtime.page_size, SHARED_STACK_SIZE, co_wrapper);
+  }
+  p->shared_owner = next;
+#else
+  (void)p;
+  (void)next;
+#endif
+}
+
+// 每次切换回来后执行: 释放上一个结束协程的栈 (切换前它仍在使用该栈),
+// 将让出的协程放回队列, 在G0上时还要完成共享栈的换入
+static void schedule_tail() {
+  struct machine *m = current_m;
+  while (1) {
+    if (m->park_unlock) {
+      void (*unlock)(void *) = m->park_unlock;
+      m->park_unlock = NULL;
+      unlock(m->park_arg);
+    }
+
+    if (m->ready_g) {
+      struct co *g = m->ready_g;
+      struct processor *p = m->p;
+      m->ready_g = NULL;
+      if (p && p->policy == CO_SCHED_LIFO && !g->home && !processor_retired(p)) {
+        // LIFO: 让出的协程排在最后, 否则它总是最新放入的, 会立即再次运行
+        lifo_defer(p, g);
+      } else {
+        co_ready(g); // 函数内会判断是否需要放入全局队列
+      }
+    }
+
+    if (m->exit_g) {
+      struct co *g = m->exit_g;
+      m->exit_g = NULL;
+      global_queue_push_batch(g, g, 1);
+    }
+
+    if (m->poll_g) {
+      struct co *g = m->poll_g;
+      _Atomic(struct co *) *slot = m->poll_slot;
+      m->poll_g = NULL;
+      m->poll_slot = NULL;
+      netpoll_park(slot, g);
+    }
+
+    // 先启动定时器再加入等待列表: 加入后协程可能立即被唤醒并取消定时器
+    if (m->timer_g) {
+      struct co *g = m->timer_g;
+      m->timer_g = NULL;
+      timer_add(m->p, &g->timer);
+    }
+
+    if (m->wait_g) {
+      struct co *g = m->wait_g;
+      struct co *target = m->wait_target;
+      struct wait_node *node = m->wait_node;
+      m->wait_g = NULL;
+      m->wait_target = NULL;
+      m->wait_node = NULL;
+      if (node) {
+        wait_node_add(target, node);
+      } else {
+        wait_list_add(target, g);
+      }
+    }
+
+    if (m->dead_g) {
+      struct co *dead = m->dead_g;
+      m->dead_g = NULL;
+      if (dead->home) {
+        if (dead->home->shared_owner == dead) {
+          dead->home->shared_owner = NULL;
+        }
+        free(dead->save_buf);
+        dead->save_buf = NULL;
+        dead->save_size = 0;
+      } else {
+        stack_free(m->p, dead->stack, dead->stack_size, dead->flags);
+        dead->stack = NULL;
+      }
+      co_unref(m->p, dead);  // 释放运行中持有的引用
+    }
+
+    if (!m->shared_next) {
+      break;
+    }
+    struct co *next = m->shared_next;
+    m->shared_next = NULL;
+    shared_stack_swap(m->p, next);
+    co_context_switch(&m->g0, &next->context);
   }
 }
 
+// 把g压入target的等待列表; target已经结束时直接唤醒g
+static void wait_list_add(struct co *target, struct co *g) {
+  struct co *head = atomic_load_explicit(&target->waiters, memory_order_acquire);
+  do {
+    if (head == WAITERS_CLOSED) {
+      DEBUG_PRINT("协程 %s 已经结束，唤醒Waiter %s", target->name, g->name);
+      trace_event(CO_EV_READY, g);
+      g->status = CO_RUNNING;
+      co_ready(g);
+      return;
+    }
+    g->wait_next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&target->waiters, &head, g,
+                                                  memory_order_release, memory_order_acquire));
+}
+
+static inline int is_wait_node(struct co *w) {
+  return ((uintptr_t)w & WAIT_NODE_TAG) != 0;
+}
+
+static inline struct wait_node* to_wait_node(struct co *w) {
+  return (struct wait_node *)((uintptr_t)w & ~(uintptr_t)WAIT_NODE_TAG);
+}
+
+// 等待列表中一项的next指针
+static inline struct co** wait_link(struct co *w) {
+  return is_wait_node(w) ? &to_wait_node(w)->next : &w->wait_next;
+}
+
+// 把co_wait_timeout的等待节点压入target的等待列表; target已经结束时尝试直接唤醒
+static void wait_node_add(struct co *target, struct wait_node *node) {
+  struct co *tagged = (struct co *)((uintptr_t)node | WAIT_NODE_TAG);
+  struct co *head = atomic_load_explicit(&target->waiters, memory_order_acquire);
+  do {
+    if (head == WAITERS_CLOSED) {
+      struct co *g = atomic_exchange(&node->g, NULL);
+      wait_node_unref(node);  // 等待列表的引用
+      if (g) {
+        trace_event(CO_EV_READY, g);
+        g->status = CO_RUNNING;
+        co_ready(g);
+      }
+      return;
+    }
+    node->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&target->waiters, &head, tagged,
+                                                  memory_order_release, memory_order_acquire));
+}
+
 static void co_wrapper() {
+  schedule_tail();
+
   struct co *current = current_p->current_g;
   DEBUG_PRINT("协程 %s 开始执行", current->name);
   
+  atomic_signal_fence(memory_order_seq_cst);
+  current->nopreempt--;
   current->func(current->arg);
+  current->nopreempt++;
+  atomic_signal_fence(memory_order_seq_cst);
     
   DEBUG_PRINT("协程 %s 执行完毕", current->name);
+  trace_event(CO_EV_EXIT, current);
   current->status = CO_DEAD;
   
-  while (!list_empty(&current->waiters)) {
-    struct co *waiter = (struct co *)list_pop_front(&current->waiters);
+  // 关闭等待列表并取走其中所有的协程, 之后的co_wait直接返回
+  struct co *waiters = atomic_exchange_explicit(&current->waiters, WAITERS_CLOSED, memory_order_acq_rel);
+  // 等待列表是后进先出的, 反转后按开始等待的顺序唤醒
+  struct co *fifo = NULL;
+  while (waiters) {
+    struct co **link = wait_link(waiters);
+    struct co *next = *link;
+    *link = fifo;
+    fifo = waiters;
+    waiters = next;
+  }
+  while (fifo) {
+    struct co *waiter = fifo;
+    struct co **link = wait_link(waiter);
+    fifo = *link;
+    *link = NULL;
+    if (is_wait_node(waiter)) {
+      // co_wait_timeout的等待者, 已经超时时跳过
+      struct wait_node *node = to_wait_node(waiter);
+      waiter = atomic_exchange(&node->g, NULL);
+      wait_node_unref(node);
+      if (!waiter) {
+        continue;
+      }
+    }
     DEBUG_PRINT("唤醒Waiter %s", waiter->name);
+    trace_event(CO_EV_READY, waiter);
     waiter->status = CO_RUNNING;
 
-    public_queue_push(current_p, waiter);
+    co_ready_next(waiter);
   }
   
-  free(current->stack);
-  current->stack = NULL;
+  current_m->dead_g = current;
   
-  dead_queue_push(current);
-  
-  current_p->current_g = NULL;
   schedule();
+  assert(0); // 已结束的协程不会再被调度
 }
 
-static void dead_queue_push(struct co *g) {
-  pthread_mutex_lock(&runtime.dead_mutex);
-  
-  g->next = NULL;
-  if (runtime.dead_queue_tail) {
-    runtime.dead_queue_tail->next = g;
-  } else {
-    runtime.dead_queue_head = g;
+// ========== 栈缓存 ==========
+
+// 栈: [保护页 | 可用栈 size 字节], 整体lazy映射, 未访问的页不占用RSS
+// 保护页会让一个栈占用两个VMA, 海量协程时可用 CO_ATTR_NO_GUARD 避免触及 vm.max_map_count
+static uint8_t* stack_map(size_t size, int flags) {
+  uint8_t *stack = mmap(NULL, size + runtime.page_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  assert(stack != MAP_FAILED);
+  // P按NUMA节点分组时, 栈的物理页总是在访问它的CPU所在节点上分配: 溢出到全局栈池时
+  // 已归还物理页, 被其它节点的P取走后也会在那里重新分配, 不受进程内存策略影响
+  if (runtime.affinity && runtime.numa_nodes > 1) {
+    syscall(SYS_mbind, stack + runtime.page_size, size, MPOL_LOCAL, NULL, 0, 0);
   }
-  runtime.dead_queue_tail = g;
-  runtime.dead_queue_size++;
-  
-  pthread_mutex_unlock(&runtime.dead_mutex);
+  if (!(flags & CO_ATTR_NO_GUARD)) {
+    int ret = mprotect(stack, runtime.page_size, PROT_NONE);
+    assert(ret == 0);
+    (void)ret;
+  }
+  return stack;
+}
 
-  DEBUG_PRINT("协程 %s 添加到DEAD队列", g->name);
+static void stack_unmap(uint8_t *stack, size_t size) {
+  munmap(stack, size + runtime.page_size);
 }
 
-static void cleanup_dead_coroutines() {
-  pthread_mutex_lock(&runtime.dead_mutex);
-  
-  struct co *current = runtime.dead_queue_head;
-  while (current) {
-    struct co *next = current->next;
-    DEBUG_PRINT("清理DEAD协程 %s", current->name);
-    if (current->name) {
-      free(current->name);
-      current->name = NULL;
+// 空闲栈链表指针存放在栈顶, 即最后被访问过的页
+#define STACK_NEXT(stack) (*(uint8_t **)((stack) + runtime.page_size + STACK_SIZE - sizeof(uint8_t *)))
+
+static uint8_t* stack_alloc(struct processor *p, size_t size, int flags) {
+  // 只缓存默认大小且带保护页的栈
+  if (size != STACK_SIZE || (flags & CO_ATTR_NO_GUARD)) {
+    return stack_map(size, flags);
+  }
+
+  // 本地缓存为空时, 从全局栈池批量取回一半容量
+  if (p->stack_cache_size == 0 && runtime.stack_pool_size > 0) {
+    pthread_mutex_lock(&runtime.stack_mutex);
+    int refilled = 0;
+    while (runtime.stack_pool && p->stack_cache_size < STACK_CACHE_MAX / 2) {
+      uint8_t *stack = runtime.stack_pool;
+      runtime.stack_pool = STACK_NEXT(stack);
+      runtime.stack_pool_size--;
+      STACK_NEXT(stack) = p->stack_cache;
+      p->stack_cache = stack;
+      p->stack_cache_size++;
+      refilled = 1;
     }
-    if (current->stack) {
-      free(current->stack);
-      current->stack = NULL;
+    runtime.stack_refills += refilled;
+    pthread_mutex_unlock(&runtime.stack_mutex);
+  }
+
+  if (p->stack_cache) {
+    uint8_t *stack = p->stack_cache;
+    p->stack_cache = STACK_NEXT(stack);
+    p->stack_cache_size--;
+    p->stack_hits++;
+    return stack;
+  }
+
+  p->stack_misses++;
+  return stack_map(STACK_SIZE, 0);
+}
+
+static void stack_free(struct processor *p, uint8_t *stack, size_t size, int flags) {
+  if (size != STACK_SIZE || (flags & CO_ATTR_NO_GUARD)) {
+    stack_unmap(stack, size);
+    return;
+  }
+
+  // 本地缓存已满, 将一半溢出到全局栈池
+  // 溢出的栈先归还物理页 (保留存放链表指针的栈顶页), 池中的栈几乎不占用RSS
+  if (p->stack_cache_size >= STACK_CACHE_MAX) {
+    uint8_t *spill_head = NULL;
+    while (p->stack_cache_size > STACK_CACHE_MAX / 2) {
+      uint8_t *spill = p->stack_cache;
+      p->stack_cache = STACK_NEXT(spill);
+      p->stack_cache_size--;
+      madvise(spill + runtime.page_size, STACK_SIZE - runtime.page_size, MADV_DONTNEED);
+      STACK_NEXT(spill) = spill_head;
+      spill_head = spill;
     }
-    while (!list_empty(&current->waiters)) {
-      list_pop_front(&current->waiters);
+
+    pthread_mutex_lock(&runtime.stack_mutex);
+    while (spill_head && runtime.stack_pool_size < STACK_POOL_MAX) {
+      uint8_t *spill = spill_head;
+      spill_head = STACK_NEXT(spill);
+      STACK_NEXT(spill) = runtime.stack_pool;
+      runtime.stack_pool = spill;
+      runtime.stack_pool_size++;
     }
-    free(current);
-    current = next;
+    runtime.stack_spills++;
+    pthread_mutex_unlock(&runtime.stack_mutex);
+
+    // 全局栈池已满, 剩余的直接释放
+    stack_cache_clear(&spill_head);
   }
-  
-  runtime.dead_queue_head = NULL;
-  runtime.dead_queue_tail = NULL;
-  runtime.dead_queue_size = 0;
-  
-  pthread_mutex_unlock(&runtime.dead_mutex);
+
+  STACK_NEXT(stack) = p->stack_cache;
+  p->stack_cache = stack;
+  p->stack_cache_size++;
+}
+
+static void stack_cache_clear(uint8_t **cache) {
+  while (*cache) {
+    uint8_t *stack = *cache;
+    *cache = STACK_NEXT(stack);
+    stack_unmap(stack, STACK_SIZE);
+  }
+}
+
+// ========== 协程控制块 ==========
+
+static struct co* co_alloc(struct processor *p) {
+  // 本地缓存为空时, 从全局池批量取回一半容量, 全局池也为空时分配一个新的slab
+  if (p->co_cache_size == 0) {
+    pthread_mutex_lock(&runtime.co_mutex);
+    while (runtime.co_pool && p->co_cache_size < CO_CACHE_MAX / 2) {
+      struct co *g = runtime.co_pool;
+      runtime.co_pool = g->next;
+      runtime.co_pool_size--;
+      g->next = p->co_cache;
+      p->co_cache = g;
+      p->co_cache_size++;
+    }
+    if (p->co_cache_size == 0) {
+      struct co_slab *slab = malloc(sizeof(struct co_slab));
+      assert(slab != NULL);
+      slab->next = runtime.co_slabs;
+      runtime.co_slabs = slab;
+      for (int i = CO_SLAB_SIZE - 1; i >= 0; i--) {
+        slab->cos[i].next = p->co_cache;
+        p->co_cache = &slab->cos[i];
+      }
+      p->co_cache_size = CO_SLAB_SIZE;
+    }
+    pthread_mutex_unlock(&runtime.co_mutex);
+  }
+
+  struct co *g = p->co_cache;
+  p->co_cache = g->next;
+  p->co_cache_size--;
+  return g;
+}
+
+// 引用归零时把控制块放回p的缓存; 本地缓存已满则一半溢出到全局池
+static void co_unref(struct processor *p, struct co *g) {
+  int refs = atomic_fetch_sub_explicit(&g->refs, 1, memory_order_acq_rel);
+  assert(refs > 0);  // 重复co_release
+  if (refs != 1) {
+    return;
+  }
+  DEBUG_PRINT("回收协程 %s 的控制块", g->name);
+
+  if (p->co_cache_size >= CO_CACHE_MAX) {
+    struct co *spill_head = p->co_cache;
+    struct co *spill_tail = spill_head;
+    for (int i = 1; i < CO_CACHE_MAX / 2; i++) {
+      spill_tail = spill_tail->next;
+    }
+    p->co_cache = spill_tail->next;
+    p->co_cache_size -= CO_CACHE_MAX / 2;
+
+    pthread_mutex_lock(&runtime.co_mutex);
+    spill_tail->next = runtime.co_pool;
+    runtime.co_pool = spill_head;
+    runtime.co_pool_size += CO_CACHE_MAX / 2;
+    pthread_mutex_unlock(&runtime.co_mutex);
+  }
+
+  g->next = p->co_cache;
+  p->co_cache = g;
+  p->co_cache_size++;
+}
+
+void co_release(struct co *co) {
+  NO_PREEMPT();
+  assert(co != NULL && co != &main_co);
+  co_unref(current_p, co);
+}
+
+// 退出清理时释放协程占用的栈等资源, 控制块随slab一起释放
+static void co_destroy(struct co *g) {
+  if (g->stack) {
+    stack_unmap(g->stack, g->stack_size);
+  }
+  free(g->save_buf);
+  g->save_buf = NULL;
 }
 
 __attribute__((destructor))
 static void co_cleanup() {
   if (!runtime.initialized) return;
+
+  // main协程可能被偷取到其它M上返回, 此时M0仍在G0上运行且无法安全取消,
+  // 其余线程也可能仍在访问运行时数据, 交给进程退出回收
+  if (current_m != &main_machine) {
+    return;
+  }
     
-  DEBUG_PRINT("清理多核协程Runtime");
+  INFO_PRINT("清理多核协程Runtime");
+
+  if (runtime.sysmon_started) {
+    pthread_cancel(runtime.sysmon_thread);
+    pthread_join(runtime.sysmon_thread, NULL);
+  }
 
-  // 关闭所有处理器的线程
+  // 关闭所有处理器的线程 (包括没有P的备用M)
   for (int i = 0; i < runtime.num_machines; i++) {
     struct machine *m = runtime.machines[i];
     if (m && m != &main_machine) {
-      DEBUG_PRINT("等待处理器 %d 线程结束", m->p->id);
+      INFO_PRINT("等待M %d 线程结束", i);
       pthread_cancel(m->thread);
       pthread_join(m->thread, NULL);
-      DEBUG_PRINT("处理器 %d 线程已结束", m->p->id);
+      INFO_PRINT("M %d 线程已结束", i);
+      pthread_cond_destroy(&m->park_cond);
+      trace_ring_destroy(&m->trace);
       free(m);
     }
   }
     
   pthread_mutex_destroy(&runtime.global_mutex);
+  pthread_mutex_destroy(&runtime.idle_mutex);
+  pthread_cond_destroy(&main_machine.park_cond);
+  trace_ring_destroy(&main_machine.trace);
   
-  cleanup_dead_coroutines();
-  pthread_mutex_destroy(&runtime.dead_mutex);
     
   for (int i = 1; i < runtime.num_processors; i++) {
     if (runtime.processors[i] != &main_processor) {
       // 清理每个处理器的public队列
-      pthread_mutex_lock(&runtime.processors[i]->public_mutex);
-      while (runtime.processors[i]->public_size > 0) {
-        struct co *g = runtime.processors[i]->public_queue[runtime.processors[i]->public_head];
-        runtime.processors[i]->public_head = (runtime.processors[i]->public_head + 1) % MAX_LOCAL_QUEUE;
-        runtime.processors[i]->public_size--;
-        if (g->name) {
-          free(g->name);
-          g->name = NULL;
-        }
-        if (g->stack) {
-          free(g->stack);
-          g->stack = NULL;
-        }
-        list_clear(&g->waiters);
-        free(g);
+      struct co *g;
+      while ((g = deque_pop(&runtime.processors[i]->public_queue)) != NULL) {
+        co_destroy(g);
+      }
+      // 清理每个处理器的shared队列
+      while (runtime.processors[i]->shared_queue_head) {
+        struct co *g = runtime.processors[i]->shared_queue_head;
+        runtime.processors[i]->shared_queue_head = g->next;
+        co_destroy(g);
       }
-      pthread_mutex_unlock(&runtime.processors[i]->public_mutex);
-      pthread_mutex_destroy(&runtime.processors[i]->public_mutex);
       // 清理每个处理器的private队列
-      for (int j = 0; j < MAX_LOCAL_QUEUE; j++) {
-        struct co *g = runtime.processors[i]->private_queue[j];
-        if (g) {
-          if (g->name) {
-            free(g->name);
-            g->name = NULL;
-          }
-          if (g->stack) {
-            free(g->stack);
-            g->stack = NULL;
-          }
-          list_clear(&g->waiters);
-          free(g);
-        }
+      while (runtime.processors[i]->private_size > 0) {
+        co_destroy(private_take(runtime.processors[i]));
       }
+      processor_destroy(runtime.processors[i]);
       free(runtime.processors[i]);
     }
   }
     
-  pthread_mutex_destroy(&main_processor.public_mutex);
+  processor_destroy(&main_processor);
+  stack_unmap(main_machine.g0_stack, STACK_SIZE);
+  stack_cache_clear(&runtime.stack_pool);
+  pthread_mutex_destroy(&runtime.stack_mutex);
+
+  // 所有协程控制块都在slab中, 整体释放
+  while (runtime.co_slabs) {
+    struct co_slab *slab = runtime.co_slabs;
+    runtime.co_slabs = slab->next;
+    free(slab);
+  }
+  pthread_mutex_destroy(&runtime.co_mutex);
+
+  if (runtime.epfd >= 0) {
+    close(runtime.epfd);
+    close(runtime.wakefd);
+  }
+  for (int i = 0; i < POLL_PAGES; i++) {
+    free(atomic_load(&runtime.poll_table[i]));
+  }
     
-  DEBUG_PRINT("多核协程Runtime清理完成");
+  INFO_PRINT("多核协程Runtime清理完成");
 }
\ No newline at end of file
@@ -2,15 +2,228 @@
 #define CO_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+// 协程属性标志
+#define CO_ATTR_NO_GUARD     0x1  // 不设置栈保护页 (每个栈少占用一个VMA)
+#define CO_ATTR_SHARED_STACK 0x2  // 在所属P的共享栈上运行, 切换时只保存已用部分; 不会被其它P偷取
+#define CO_ATTR_DETACHED     0x4  // 结束后立即回收控制块, 调用者不能再使用返回的句柄
+#define CO_ATTR_NO_PREEMPT   0x8  // 开启异步抢占时也不会被抢占 (见co_set_preempt)
+
+#define CO_PRIO_MAX 7  // 优先级范围 0 到 CO_PRIO_MAX
+#define CO_WEIGHT_DEFAULT 100  // 权重范围 1 到 CO_WEIGHT_MAX, 0 表示默认值
+#define CO_WEIGHT_MAX 10000
+
+// 调度类 (CO_SCHED_FAIR 策略下生效): LATENCY 先于 NORMAL 先于 BACKGROUND 运行,
+// 但有协程等待的较低类每 10ms 至少运行一次, 不会被饿死
+enum co_sched_class { CO_CLASS_NORMAL, CO_CLASS_LATENCY, CO_CLASS_BACKGROUND, CO_CLASS_COUNT };
+
+// 协程属性
+struct co_attr {
+  const char *name;   // 最多保留31个字符
+  size_t stack_size;  // 0 表示默认 64KB, 按页对齐, 最小 16KB
+  int flags;          // CO_ATTR_* 的组合
+  int priority;       // 0 到 CO_PRIO_MAX, 数字大的先运行; 只在 CO_SCHED_PRIORITY 策略下生效
+  int sched_class;    // enum co_sched_class, 只在 CO_SCHED_FAIR 策略下生效
+  int weight;         // 同一调度类中按权重分配运行时间, 只在 CO_SCHED_FAIR 策略下生效
+};
 
 // 基本协程API
 struct co* co_start(const char *name, void (*func)(void *), void *arg);
+struct co* co_start_attr(const struct co_attr *attr, void (*func)(void *), void *arg);
 void co_yield();
 void co_wait(struct co *co);
+// 挂起当前协程至少ns纳秒, 不阻塞M; 精度为时间轮的刻度 (约65us)
+void co_sleep(uint64_t ns);
+// 同co_wait, 但最多等待ns纳秒: co结束返回0, 超时返回-1并设置errno为ETIMEDOUT
+int co_wait_timeout(struct co *co, uint64_t ns);
+
+// 协程同步原语: 无竞争时只需一次原子操作; 竞争时挂起当前协程而不是阻塞M,
+// 持有者即使挂起在同一M上也不会死锁。可以用 {0} 静态初始化 (信号量初始值为0)。
+// 计数器只用于观察竞争情况, 不加锁读取。被唤醒的等待者 (包括co_wait和通道) 在唤醒它的协程让出或
+// 挂起后优先在同一P上运行 (runnext); 唤醒者之后一直计算时由空闲的M偷走运行。环境变量 CO_RUNNEXT=0 关闭
+struct co_mutex {
+  atomic_int state;
+  atomic_int lock;          // 保护等待队列的自旋锁
+  struct co *head;          // 等待队列
+  struct co *tail;
+  unsigned long contended;  // 需要挂起等待的加锁次数
+  unsigned long handoffs;   // 解锁时直接把锁交给等待者的次数
+};
+void co_mutex_init(struct co_mutex *mu);
+void co_mutex_lock(struct co_mutex *mu);
+int co_mutex_trylock(struct co_mutex *mu);  // 成功返回1
+void co_mutex_unlock(struct co_mutex *mu);
+
+struct co_cond {
+  atomic_int lock;
+  struct co *head;
+  struct co *tail;
+  unsigned long waits;      // co_cond_wait的次数
+};
+void co_cond_init(struct co_cond *cond);
+void co_cond_wait(struct co_cond *cond, struct co_mutex *mu);  // 返回时重新持有mu
+void co_cond_signal(struct co_cond *cond);
+void co_cond_broadcast(struct co_cond *cond);
+
+struct co_sem {
+  atomic_int count;
+  atomic_int nwait;         // 等待者数量, co_sem_post据此决定是否需要唤醒
+  atomic_int lock;
+  struct co *head;
+  struct co *tail;
+  unsigned long contended;  // 需要挂起等待的次数
+};
+void co_sem_init(struct co_sem *sem, int value);
+void co_sem_wait(struct co_sem *sem);
+int co_sem_trywait(struct co_sem *sem);  // 成功返回1
+void co_sem_post(struct co_sem *sem);    // 有等待者时把这一单位直接交给最早的等待者
+
+// 通道: 元素按值拷贝, 大小在创建时指定; cap为0时发送方直接把数据拷贝到等待中的接收方
+// (反之亦然), 否则最多缓冲cap个元素。发送/接收在通道满/空时挂起当前协程
+struct co_chan;
+struct co_chan* co_chan_new(size_t elem_size, int cap);
+void co_chan_free(struct co_chan *ch);        // 调用时不能有协程挂起在通道上
+int co_chan_send(struct co_chan *ch, const void *elem);  // 成功返回0, 通道已关闭返回-1 (errno=EPIPE)
+int co_chan_recv(struct co_chan *ch, void *elem);        // 收到数据返回1, 已关闭且取空返回0 (elem清零)
+void co_chan_close(struct co_chan *ch);       // 唤醒所有等待者, 缓冲区中剩余的元素仍可接收
+
+enum co_chan_op {
+  CO_CHAN_SEND,
+  CO_CHAN_RECV
+};
+
+struct co_select_case {
+  struct co_chan *chan;  // NULL的case永远不会被选中
+  int op;                // CO_CHAN_SEND 或 CO_CHAN_RECV
+  void *elem;            // 发送的数据或接收的缓冲区
+  int ok;                // 输出: 1 完成了通信, 0 通道已关闭
+};
+#define CO_SELECT_MAX 32
+// 等待多个case中任意一个可以进行, 执行它并返回下标; 多个case同时就绪时随机选择。
+// block为0且没有就绪的case, 或所有case的chan都为NULL时返回-1
+int co_select(struct co_select_case *cases, int n, int block);
+// 调用者不再使用co的句柄 (包括co_wait), co结束后其控制块可以被新协程复用
+void co_release(struct co *co);
+
+// 网络I/O: fd第一次使用时被设为非阻塞并注册到epoll, 暂时无法完成时只挂起当前协程,
+// 同一M上的其它协程继续运行; 没有可运行协程的M在epoll_wait中等待fd就绪
+ssize_t co_read(int fd, void *buf, size_t count);
+ssize_t co_write(int fd, const void *buf, size_t count);  // 写完count字节或出错才返回
+int co_accept(int fd, struct sockaddr *addr, socklen_t *addrlen);  // 返回的连接已是非阻塞的
+int co_connect(int fd, const struct sockaddr *addr, socklen_t addrlen);
+int co_close(int fd);  // 注销fd并唤醒仍在等待它的协程, 再关闭fd
+
+// 阻塞调用: 在可能长时间阻塞的系统调用或库函数前后调用。阻塞超过约20us且P上还有其它
+// 可运行的协程时, 监控线程把P转交给备用M继续调度; 返回后协程被放入全局队列由任意P继续执行。
+// 共享栈协程不转交P。没有被转交时开销只有几次原子操作
+void co_enter_blocking();
+void co_exit_blocking();
 
-// 多核协程API
+// I/O后端: 默认基于epoll就绪通知 (CO_IO_EPOLL); CO_IO_URING 时上面的函数改为向当前P的
+// io_uring提交请求, 本P没有其它可运行的协程时一次批量提交, 完成后由调度器唤醒协程。
+// 此模式下co_accept返回阻塞的连接, 由内核完成等待。内核不支持io_uring时回退到epoll,
+// 返回实际使用的后端; 也可用环境变量 CO_IO_BACKEND=uring 选择
+enum co_io_backend { CO_IO_EPOLL, CO_IO_URING };
+int co_set_io_backend(int backend);
+int co_get_io_backend();
+
+// 多核协程API: P的数量按需增长到GOMAXPROCS, 有新工作而没有空闲的M时自动启动工作M。
+// co_thread立即增加一个P并在其上运行start_routine, P已达到上限 (包括按需启动的) 时返回-1。
+// co_set_gomaxprocs可以随时调用: 缩小时多出的P把队列中的协程交给其它P后停止调度
+// (正在运行且不让出的协程要等它让出), 扩大时重新启用
 int co_thread(void *(*start_routine)(void *), void *arg);
-void co_set_gomaxprocs(int procs);
+void co_set_gomaxprocs(int procs);  // 1到64
 int co_get_gomaxprocs();
 
+// 固定调度随机数种子 (也可用环境变量 CO_SCHED_SEED 设置), 每个P的种子由它和P的id导出。
+// 同时重置各P的调度计数; 应在没有其它M运行协程时调用, 相同的种子和负载得到相同的调度顺序
+void co_set_sched_seed(unsigned long long seed);
+
+// 异步抢占 (默认关闭): ns不为0时, 连续运行超过ns纳秒没有让出的协程被强制co_yield。
+// 监控线程向其M发送SIGURG, 只在安全点抢占: 协程正在执行可执行文件自身的代码, 且不在co_*函数内部;
+// 执行libc等共享库代码时不抢占。被中断的系统调用自动重启, 但nanosleep等会返回EINTR。
+// main协程、共享栈协程和以CO_ATTR_NO_PREEMPT创建的协程不会被抢占; ns为0时关闭
+void co_set_preempt(uint64_t ns);
+
+// CPU亲和性 (默认关闭, 也可用环境变量 CO_AFFINITY=1 开启): 每个P的M绑定到一个CPU, P按id依次
+// 占满一个NUMA节点的CPU再用下一个节点。工作窃取先找同一节点上的P, 协程栈的物理页在使用它的
+// CPU所在节点上分配。关闭时恢复开启前的亲和性掩码; 成功返回0, 读取拓扑或绑定失败返回-1
+int co_set_affinity(int enable);
+
+// 调度策略: 决定P从本地队列中选择下一个协程的顺序, 全局队列总是FIFO。
+// CO_SCHED_RANDOM (默认) 随机; CO_SCHED_FIFO 先放入的先运行;
+// CO_SCHED_LIFO 最新放入的先运行 (深度优先, 其它P从最早的一端偷取), 让出的协程排在最后;
+// CO_SCHED_PRIORITY 按co_attr.priority从高到低, 同一优先级先放入的先运行;
+// CO_SCHED_FAIR 按co_attr.sched_class选择调度类, 类中按co_attr.weight加权公平 (虚拟运行时间最小的先运行)。
+// 也可用环境变量 CO_SCHED_POLICY=random/fifo/lifo/priority/fair 设置
+enum co_sched_policy { CO_SCHED_RANDOM, CO_SCHED_FIFO, CO_SCHED_LIFO, CO_SCHED_PRIORITY, CO_SCHED_FAIR };
+int co_set_sched_policy(int policy);        // 所有P在下一次调度时切换, 策略无效时返回-1
+int co_set_local_sched_policy(int policy);  // 只修改当前协程所在的P, 立即生效
+int co_get_sched_policy();                  // 当前协程所在P的策略
+
+// 栈缓存统计
+struct co_stack_stats {
+  unsigned long hits;     // 从P本地缓存取得栈的次数
+  unsigned long misses;   // 需要malloc新栈的次数
+  unsigned long spills;   // 本地缓存溢出到全局栈池的次数
+  unsigned long refills;  // 从全局栈池补充本地缓存的次数
+};
+void co_get_stack_stats(struct co_stack_stats *stats);
+
+// 空闲M休眠/唤醒统计
+struct co_sched_stats {
+  unsigned long parks;             // 空闲M进入休眠的次数
+  unsigned long wakeups;           // 休眠的M被新工作唤醒的次数
+  unsigned long spurious_wakeups;  // 被唤醒后没有找到工作又再次休眠的次数
+  unsigned long wake_latency_avg_ns;  // 从唤醒到M实际醒来的平均耗时
+  unsigned long wake_latency_max_ns;
+  unsigned long syscall_handoffs;  // 阻塞调用期间P被转交给其它M的次数
+  unsigned long preemptions;       // 协程被异步抢占的次数
+  unsigned long workers_started;   // 按需自动启动的工作M数量
+  unsigned long steals;            // 从其它P偷取到协程的次数
+  unsigned long remote_steals;     // 其中从其它NUMA节点的P偷取的次数
+};
+void co_get_sched_stats(struct co_sched_stats *stats);
+
+// 每个调度类的统计, 只在 CO_SCHED_FAIR 策略下累计
+struct co_class_stats {
+  unsigned long runtime_ns[CO_CLASS_COUNT];    // 该类协程累计运行时间
+  unsigned long runs[CO_CLASS_COUNT];          // 从本地队列被选中运行的次数
+  unsigned long starved_runs[CO_CLASS_COUNT];  // 其中因防饿死保证先于更高的类运行的次数
+};
+void co_get_class_stats(struct co_class_stats *stats);
+
+// 调度事件追踪: 编译时定义 CO_TRACE (make TRACE=1) 才会记录, 否则读取结果为空。
+// 每个M把事件写入自己的无锁环形缓冲区 (保留最近4095个), 记录时不加锁也不格式化
+enum co_trace_type {
+  CO_EV_CREATE,   // 创建协程
+  CO_EV_RUN,      // 切换到协程
+  CO_EV_YIELD,    // 协程调用co_yield
+  CO_EV_WAIT,     // 协程开始等待另一个协程
+  CO_EV_READY,    // 等待中的协程被唤醒
+  CO_EV_EXIT,     // 协程执行完毕
+  CO_EV_STEAL,    // 从其它P偷取到协程
+  CO_EV_GLOBAL,   // 从全局队列取到协程
+  CO_EV_PARK,     // M进入休眠
+  CO_EV_UNPARK,   // M被唤醒
+};
+
+struct co_trace_event {
+  uint64_t ts_ns;   // CLOCK_MONOTONIC
+  uint64_t co_id;   // 协程id, main协程为1; M的事件为0
+  int32_t type;     // enum co_trace_type
+  int32_t p_id;
+};
+
+// 读取第m个M (0为主线程) 最近的至多max个事件, 按时间顺序, 返回事件数
+size_t co_trace_read(int m, struct co_trace_event *buf, size_t max);
+// 以文本形式输出所有M的事件
+void co_trace_dump(FILE *out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "context.h"
+#include <stdint.h>
+
+#ifdef CO_USE_UCONTEXT
+
+void co_context_init(co_context_t *ctx, void *stack, size_t size, void (*entry)(void)) {
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp = stack;
+  ctx->uc.uc_stack.ss_size = size;
+  ctx->uc.uc_link = NULL;
+  makecontext(&ctx->uc, entry, 0);
+}
+
+void co_context_switch(co_context_t *from, co_context_t *to) {
+  swapcontext(&from->uc, &to->uc);
+}
+
+#else
+
+// 汇编实现的 co_context_switch(from, to):
+// 把 callee-saved 寄存器 (以及浮点控制字) 压到当前栈上, 保存 SP 到 from->sp,
+// 再从 to->sp 恢复并 ret 到对方保存的返回地址。PC 即栈上的返回地址。
+#if defined(__x86_64__)
+
+// 栈帧 (从低到高): [mxcsr|x87 cw] r15 r14 r13 r12 rbx rbp ret
+#ifndef CO_CONTEXT_NO_FPU
+#define CO_FPU_SAVE    "  subq $8, %rsp\n  stmxcsr (%rsp)\n  fnstcw 4(%rsp)\n"
+#define CO_FPU_RESTORE "  ldmxcsr (%rsp)\n  fldcw 4(%rsp)\n  addq $8, %rsp\n"
+#else
+#define CO_FPU_SAVE    "  subq $8, %rsp\n"
+#define CO_FPU_RESTORE "  addq $8, %rsp\n"
+#endif
+
+__asm__(
+  ".text\n"
+  ".globl co_context_switch\n"
+  ".type co_context_switch, @function\n"
+  ".p2align 4\n"
+  "co_context_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  CO_FPU_SAVE
+  "  movq %rsp, (%rdi)\n"
+  "  movq (%rsi), %rsp\n"
+  CO_FPU_RESTORE
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size co_context_switch, .-co_context_switch\n"
+);
+
+void co_context_init(co_context_t *ctx, void *stack, size_t size, void (*entry)(void)) {
+  uint64_t *sp = (uint64_t *)(((uintptr_t)stack + size) & ~(uintptr_t)15);
+  *--sp = 0;                  // entry 的伪返回地址, 保证进入 entry 时 rsp % 16 == 8
+  *--sp = (uint64_t)entry;    // ret 的目标
+  for (int i = 0; i < 6; i++) {
+    *--sp = 0;                // rbp rbx r12-r15
+  }
+  uint32_t mxcsr = 0x1F80;
+  uint16_t fcw = 0x037F;
+#ifndef CO_CONTEXT_NO_FPU
+  __asm__ volatile("stmxcsr %0" : "=m"(mxcsr));
+  __asm__ volatile("fnstcw %0" : "=m"(fcw));
+#endif
+  *--sp = (uint64_t)mxcsr | ((uint64_t)fcw << 32);
+  ctx->sp = sp;
+}
+
+#elif defined(__aarch64__)
+
+// 栈帧 176 字节: x19-x28, x29(fp), x30(lr), d8-d15, fpcr, 对齐填充
+#ifndef CO_CONTEXT_NO_FPU
+#define CO_FPU_SAVE    "  mrs x9, fpcr\n  str x9, [sp, #160]\n"
+#define CO_FPU_RESTORE "  ldr x9, [sp, #160]\n  msr fpcr, x9\n"
+#else
+#define CO_FPU_SAVE    ""
+#define CO_FPU_RESTORE ""
+#endif
+
+__asm__(
+  ".text\n"
+  ".globl co_context_switch\n"
+  ".type co_context_switch, %function\n"
+  ".p2align 4\n"
+  "co_context_switch:\n"
+  "  sub sp, sp, #176\n"
+  "  stp x19, x20, [sp, #0]\n"
+  "  stp x21, x22, [sp, #16]\n"
+  "  stp x23, x24, [sp, #32]\n"
+  "  stp x25, x26, [sp, #48]\n"
+  "  stp x27, x28, [sp, #64]\n"
+  "  stp x29, x30, [sp, #80]\n"
+  "  stp d8, d9, [sp, #96]\n"
+  "  stp d10, d11, [sp, #112]\n"
+  "  stp d12, d13, [sp, #128]\n"
+  "  stp d14, d15, [sp, #144]\n"
+  CO_FPU_SAVE
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  ldr x9, [x1]\n"
+  "  mov sp, x9\n"
+  CO_FPU_RESTORE
+  "  ldp x19, x20, [sp, #0]\n"
+  "  ldp x21, x22, [sp, #16]\n"
+  "  ldp x23, x24, [sp, #32]\n"
+  "  ldp x25, x26, [sp, #48]\n"
+  "  ldp x27, x28, [sp, #64]\n"
+  "  ldp x29, x30, [sp, #80]\n"
+  "  ldp d8, d9, [sp, #96]\n"
+  "  ldp d10, d11, [sp, #112]\n"
+  "  ldp d12, d13, [sp, #128]\n"
+  "  ldp d14, d15, [sp, #144]\n"
+  "  add sp, sp, #176\n"
+  "  ret\n"
+  ".size co_context_switch, .-co_context_switch\n"
+);
+
+void co_context_init(co_context_t *ctx, void *stack, size_t size, void (*entry)(void)) {
+  uint64_t *sp = (uint64_t *)((((uintptr_t)stack + size) & ~(uintptr_t)15) - 176);
+  for (int i = 0; i < 22; i++) {
+    sp[i] = 0;
+  }
+  sp[11] = (uint64_t)entry;   // x30, ret 的目标
+#ifndef CO_CONTEXT_NO_FPU
+  uint64_t fpcr;
+  __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+  sp[20] = fpcr;
+#endif
+  ctx->sp = sp;
+}
+
+#endif
+
+#endif // CO_USE_UCONTEXT
@@ -0,0 +1,34 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stddef.h>
+
+// 上下文切换实现选择:
+//   默认在 x86-64 / AArch64 上使用手写汇编, 只保存 callee-saved 寄存器与 SP/PC,
+//   不像 swapcontext 那样每次切换都执行 rt_sigprocmask 系统调用。
+//   其它架构或编译时定义 CO_USE_UCONTEXT (make CONTEXT=ucontext) 时回退到 ucontext。
+//   定义 CO_CONTEXT_NO_FPU 可跳过浮点控制字 (MXCSR/x87 CW, FPCR) 的保存。
+#if !defined(CO_USE_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+#define CO_USE_UCONTEXT
+#endif
+
+#ifdef CO_USE_UCONTEXT
+#include <ucontext.h>
+
+typedef struct co_context {
+  ucontext_t uc;
+} co_context_t;
+#else
+typedef struct co_context {
+  void *sp;  // 切出时的栈顶, 寄存器保存在栈上
+} co_context_t;
+#endif
+
+// 在 [stack, stack + size) 上初始化上下文, 首次切入时从 entry 开始执行。
+// entry 不能返回。
+void co_context_init(co_context_t *ctx, void *stack, size_t size, void (*entry)(void));
+
+// 保存当前执行状态到 from, 并切换到 to。
+void co_context_switch(co_context_t *from, co_context_t *to);
+
+#endif // CONTEXT_H
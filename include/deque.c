@@ -0,0 +1,78 @@
+#include "deque.h"
+#include <stdlib.h>
+#include <assert.h>
+
+void deque_init(struct deque *dq, long capacity) {
+  assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  atomic_init(&dq->top, 0);
+  atomic_init(&dq->bottom, 0);
+  dq->buffer = calloc(capacity, sizeof(*dq->buffer));
+  assert(dq->buffer != NULL);
+  dq->capacity = capacity;
+}
+
+void deque_destroy(struct deque *dq) {
+  free(dq->buffer);
+  dq->buffer = NULL;
+  dq->capacity = 0;
+}
+
+int deque_push(struct deque *dq, void *data) {
+  long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+  if (b - t >= dq->capacity) {
+    return 0;
+  }
+  atomic_store_explicit(&dq->buffer[b & (dq->capacity - 1)], data, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+  return 1;
+}
+
+void* deque_pop(struct deque *dq) {
+  long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+  if (t > b) {
+    // 队列为空
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  void *data = atomic_load_explicit(&dq->buffer[b & (dq->capacity - 1)], memory_order_relaxed);
+  if (t == b) {
+    // 最后一个元素, 与窃取者竞争
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+      data = NULL;
+    }
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+  }
+  return data;
+}
+
+void* deque_steal(struct deque *dq) {
+  while (1) {
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+    if (t >= b) {
+      return NULL;
+    }
+
+    void *data = atomic_load_explicit(&dq->buffer[t & (dq->capacity - 1)], memory_order_relaxed);
+    if (atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                memory_order_seq_cst, memory_order_relaxed)) {
+      return data;
+    }
+    // 与其它窃取者或所有者竞争失败, 重试
+  }
+}
+
+long deque_size(struct deque *dq) {
+  long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+  long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+  return b > t ? b - t : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stdatomic.h>
+
+// Chase-Lev 无锁工作窃取双端队列
+// - 只有队列的所有者可以调用 deque_push / deque_pop, 二者操作 bottom 端
+// - 任意线程都可以调用 deque_steal, 从 top 端取走最早放入的元素
+// 内存序参考 Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP'13)
+struct deque {
+  _Alignas(64) atomic_long top;     // 窃取端, 由窃取者通过CAS推进
+  _Alignas(64) atomic_long bottom;  // 所有者端
+  _Atomic(void *) *buffer;
+  long capacity;                    // 2的幂
+};
+
+void deque_init(struct deque *dq, long capacity);
+void deque_destroy(struct deque *dq);
+int deque_push(struct deque *dq, void *data);  // 队列已满时返回0
+void* deque_pop(struct deque *dq);             // 队列为空时返回NULL
+void* deque_steal(struct deque *dq);           // 队列为空时返回NULL
+long deque_size(struct deque *dq);             // 近似值, 只用于判断/统计
+
+#endif // DEQUE_H
@@ -0,0 +1,48 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <assert.h>
+
+void trace_ring_init(struct trace_ring *r) {
+  atomic_init(&r->head, 0);
+  r->events = calloc(TRACE_RING_SIZE, sizeof(*r->events));
+  assert(r->events != NULL);
+}
+
+void trace_ring_destroy(struct trace_ring *r) {
+  free(r->events);
+  r->events = NULL;
+}
+
+// 按时间顺序拷贝最近的至多max个事件, 返回拷贝的数量
+size_t trace_ring_read(struct trace_ring *r, struct co_trace_event *buf, size_t max) {
+  if (!r->events) {
+    return 0;
+  }
+  uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+  // 写入方下一次写入的槽位就是最早事件所在的槽位, 最多只能读取 TRACE_RING_SIZE-1 个
+  uint64_t start = head >= TRACE_RING_SIZE ? head - TRACE_RING_SIZE + 1 : 0;
+  if (head - start > max) {
+    start = head - max;
+  }
+
+  for (uint64_t i = start; i < head; i++) {
+    buf[i - start] = r->events[i & (TRACE_RING_SIZE - 1)];
+  }
+
+  // 拷贝期间写入方可能已经绕回覆盖了最早的一部分 (包括正在写入的第now个事件
+  // 所占的槽位), 丢弃这些事件
+  atomic_thread_fence(memory_order_acquire);
+  uint64_t now = atomic_load_explicit(&r->head, memory_order_relaxed);
+  uint64_t valid = now + 1 > TRACE_RING_SIZE ? now + 1 - TRACE_RING_SIZE : 0;
+  if (valid <= start) {
+    return head - start;
+  }
+  if (valid >= head) {
+    return 0;
+  }
+  size_t skip = valid - start;
+  for (uint64_t i = 0; i < head - valid; i++) {
+    buf[i] = buf[i + skip];
+  }
+  return head - valid;
+}
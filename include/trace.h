@@ -0,0 +1,37 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "co.h"
+
+// 每个M一个的二进制事件环形缓冲区
+// - 只有所属M调用 trace_ring_record 写入, 不加锁, 不格式化
+// - 任意线程都可以调用 trace_ring_read 读取快照, 读取期间被覆盖的事件会被丢弃
+#define TRACE_RING_SIZE 4096  // 2的幂
+
+struct trace_ring {
+  _Atomic uint64_t head;  // 已写入的事件总数
+  struct co_trace_event *events;
+};
+
+void trace_ring_init(struct trace_ring *r);
+void trace_ring_destroy(struct trace_ring *r);
+size_t trace_ring_read(struct trace_ring *r, struct co_trace_event *buf, size_t max);
+
+static inline void trace_ring_record(struct trace_ring *r, int type, uint64_t co_id, int p_id) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  uint64_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+  struct co_trace_event *e = &r->events[h & (TRACE_RING_SIZE - 1)];
+  e->ts_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+  e->co_id = co_id;
+  e->type = type;
+  e->p_id = p_id;
+  atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+#endif // TRACE_H
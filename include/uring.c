@@ -0,0 +1,159 @@
+#include "uring.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(struct uring *r, unsigned entries) {
+  memset(r, 0, sizeof(*r));
+  r->fd = -1;
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = sys_io_uring_setup(entries, &p);
+  if (fd < 0) {
+    return -1;
+  }
+
+  r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (r->cq_ring_size > r->sq_ring_size) {
+      r->sq_ring_size = r->cq_ring_size;
+    }
+    r->cq_ring_size = r->sq_ring_size;
+  }
+
+  r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (r->sq_ring == MAP_FAILED) {
+    goto fail;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    r->cq_ring = r->sq_ring;
+  } else {
+    r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (r->cq_ring == MAP_FAILED) {
+      munmap(r->sq_ring, r->sq_ring_size);
+      goto fail;
+    }
+  }
+
+  r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED) {
+    if (r->cq_ring != r->sq_ring) {
+      munmap(r->cq_ring, r->cq_ring_size);
+    }
+    munmap(r->sq_ring, r->sq_ring_size);
+    goto fail;
+  }
+
+  uint8_t *sq = r->sq_ring;
+  r->sq_head = (unsigned *)(sq + p.sq_off.head);
+  r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned *)(sq + p.sq_off.array);
+  r->sq_local_tail = *r->sq_tail;
+
+  uint8_t *cq = r->cq_ring;
+  r->cq_head = (unsigned *)(cq + p.cq_off.head);
+  r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  r->features = p.features;
+  r->fd = fd;
+  return 0;
+
+fail:
+  {
+    int err = errno;
+    close(fd);
+    errno = err;
+  }
+  return -1;
+}
+
+void uring_destroy(struct uring *r) {
+  if (r->fd < 0) {
+    return;
+  }
+  munmap(r->sqes, r->sqes_size);
+  if (r->cq_ring != r->sq_ring) {
+    munmap(r->cq_ring, r->cq_ring_size);
+  }
+  munmap(r->sq_ring, r->sq_ring_size);
+  close(r->fd);
+  r->fd = -1;
+}
+
+struct io_uring_sqe* uring_get_sqe(struct uring *r) {
+  unsigned head = atomic_load_explicit((_Atomic unsigned *)r->sq_head, memory_order_acquire);
+  unsigned mask = *r->sq_mask;
+  if (r->sq_local_tail - head > mask) {
+    return NULL;
+  }
+  unsigned idx = r->sq_local_tail & mask;
+  struct io_uring_sqe *sqe = &r->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  r->sq_array[idx] = idx;
+  r->sq_local_tail++;
+  return sqe;
+}
+
+int uring_submit(struct uring *r) {
+  unsigned tail = *r->sq_tail;
+  if (tail != r->sq_local_tail) {
+    // SQE内容必须在内核看到新的tail之前可见
+    r->to_submit += r->sq_local_tail - tail;
+    atomic_store_explicit((_Atomic unsigned *)r->sq_tail, r->sq_local_tail, memory_order_release);
+  }
+  if (r->to_submit == 0) {
+    return 0;
+  }
+  int ret;
+  do {
+    ret = sys_io_uring_enter(r->fd, r->to_submit, 0, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) {
+    // EAGAIN/EBUSY: 内核暂时无法接收, 保留到下次提交
+    return -1;
+  }
+  r->to_submit -= ret;
+  return ret;
+}
+
+int uring_register_eventfd(struct uring *r, int efd) {
+  return sys_io_uring_register(r->fd, IORING_REGISTER_EVENTFD, &efd, 1);
+}
+
+struct io_uring_cqe* uring_peek_cqe(struct uring *r) {
+  unsigned head = *r->cq_head;
+  unsigned tail = atomic_load_explicit((_Atomic unsigned *)r->cq_tail, memory_order_acquire);
+  if (head == tail) {
+    return NULL;
+  }
+  return &r->cqes[head & *r->cq_mask];
+}
+
+void uring_cqe_seen(struct uring *r) {
+  atomic_store_explicit((_Atomic unsigned *)r->cq_head, *r->cq_head + 1, memory_order_release);
+}
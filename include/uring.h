@@ -0,0 +1,41 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+// 最小的 io_uring 封装, 直接使用系统调用, 不依赖 liburing
+// - 只有环的所有者 (一个P) 可以获取SQE、提交和收割CQE
+// - uring_get_sqe 只在本地推进SQ tail, 由 uring_submit 一次性交给内核
+struct uring {
+  int fd;                       // -1 表示未初始化或不可用
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned sq_local_tail;       // 已填写但还没有发布给内核的SQE的尾部
+  unsigned to_submit;           // 已发布但还没有通过io_uring_enter提交的SQE数
+
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;                // 支持 IORING_FEAT_SINGLE_MMAP 时与sq_ring相同
+  size_t cq_ring_size;
+  size_t sqes_size;
+  unsigned features;
+};
+
+int uring_init(struct uring *r, unsigned entries);      // 内核不支持时返回-1并设置errno
+void uring_destroy(struct uring *r);
+struct io_uring_sqe* uring_get_sqe(struct uring *r);   // SQ已满时返回NULL
+int uring_submit(struct uring *r);                      // 提交所有已填写的SQE, 返回提交数
+int uring_register_eventfd(struct uring *r, int efd);   // 有CQE时向efd写入
+struct io_uring_cqe* uring_peek_cqe(struct uring *r);   // 没有完成事件时返回NULL
+void uring_cqe_seen(struct uring *r);                   // 消费uring_peek_cqe返回的CQE
+
+#endif // URING_H
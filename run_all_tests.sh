@@ -8,7 +8,7 @@ BLUE='\033[0;34m'
 NC='\033[0m' # No Color
 
 # 测试程序列表（按照Makefile中的顺序）
-TESTS=("test1" "test2" "test_multi_wait" "test_multi_core" "test_public")
+TESTS=("test1" "test2" "test_multi_wait" "test_multi_core" "test_public" "test_stack_cache" "test_stack_attr" "test_shared_stack" "test_deque" "test_steal_stress" "test_local_queue" "test_global_fairness" "test_sched_seed" "test_idle_park" "test_trace" "test_wait_race" "test_co_slab" "test_co_reclaim" "test_netpoll" "test_uring" "test_timer" "test_sync" "test_chan" "test_blocking" "test_preempt" "test_gomaxprocs" "test_affinity" "test_runnext" "test_sched_policy" "test_sched_fair")
 
 # 函数：打印分隔线
 print_separator() {
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "co.h"
+
+// CPU亲和性测试:
+// 1. 开启后每个运行协程的线程只绑定一个CPU, 不同的P绑定不同的CPU (CPU足够时)
+// 2. 工作窃取统计: 跨节点偷取次数不超过偷取次数, 所有协程都完成
+// 3. 关闭后各线程恢复开启前的亲和性掩码
+
+#define MS 1000000LL
+#define NUM_PROCS 4
+#define NUM_WORKERS 16
+#define ROUNDS 10
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void spin(long long ns) {
+    long long end = now_ns() + ns;
+    while (now_ns() < end) {
+    }
+}
+
+// 运行过协程的线程及其亲和性掩码
+static struct co_mutex seen_mutex = {0};
+static pthread_t seen[64];
+static cpu_set_t seen_mask[64];
+static int num_seen = 0;
+
+static void see_thread() {
+    pthread_t self = pthread_self();
+    cpu_set_t mask;
+    pthread_getaffinity_np(self, sizeof(mask), &mask);
+    co_mutex_lock(&seen_mutex);
+    int i = 0;
+    while (i < num_seen && !pthread_equal(seen[i], self)) i++;
+    if (i < 64) {
+        seen[i] = self;
+        seen_mask[i] = mask;  // 保留最后一次看到的掩码
+        if (i == num_seen) num_seen++;
+    }
+    co_mutex_unlock(&seen_mutex);
+}
+
+void worker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ROUNDS; i++) {
+        see_thread();
+        spin(MS / 2);
+        co_yield();
+    }
+}
+
+static void run_batch() {
+    num_seen = 0;
+    struct co *cos[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        cos[i] = co_start("worker", worker, NULL);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        co_wait(cos[i]);
+        co_release(cos[i]);
+    }
+}
+
+int main() {
+    printf("=== CPU亲和性测试 ===\n");
+    co_set_gomaxprocs(NUM_PROCS);
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int ncpu = CPU_COUNT(&allowed);
+
+    // 1. 开启
+    if (co_set_affinity(1) != 0) {
+        printf("co_set_affinity失败\n");
+        printf("CPU亲和性测试 FAILED\n");
+        return 1;
+    }
+    run_batch();
+    cpu_set_t used;
+    CPU_ZERO(&used);
+    int pinned = 1;
+    for (int i = 0; i < num_seen; i++) {
+        pinned = pinned && CPU_COUNT(&seen_mask[i]) == 1;
+        CPU_OR(&used, &used, &seen_mask[i]);
+    }
+    // CPU少于P时P循环使用CPU, 只能检查不超过线程数
+    int distinct = ncpu >= NUM_PROCS ? CPU_COUNT(&used) == num_seen : CPU_COUNT(&used) <= num_seen;
+    printf("开启: %d 个线程, 都只绑定一个CPU: %s, 使用 %d 个不同的CPU (共 %d 个可用)\n",
+           num_seen, pinned ? "是" : "否", CPU_COUNT(&used), ncpu);
+    int pin_ok = num_seen >= 1 && pinned && distinct;
+
+    // 2. 偷取统计
+    struct co_sched_stats stats;
+    co_get_sched_stats(&stats);
+    printf("偷取 %lu 次, 其中跨节点 %lu 次\n", stats.steals, stats.remote_steals);
+    int steal_ok = stats.remote_steals <= stats.steals;
+
+    // 3. 关闭
+    co_set_affinity(0);
+    run_batch();
+    int restored = 1;
+    for (int i = 0; i < num_seen; i++) {
+        restored = restored && CPU_EQUAL(&seen_mask[i], &allowed);
+    }
+    printf("关闭: %d 个线程恢复了原来的 %d 个CPU: %s\n", num_seen, ncpu, restored ? "是" : "否");
+    int restore_ok = restored;
+
+    if (pin_ok && steal_ok && restore_ok) {
+        printf("CPU亲和性测试 PASSED\n");
+        return 0;
+    }
+    printf("CPU亲和性测试 FAILED\n");
+    return 1;
+}
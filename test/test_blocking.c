@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include "co.h"
+
+// 阻塞调用转交P测试:
+// 1. 只有一个P时, 一个协程在co_enter_blocking/co_exit_blocking之间阻塞200ms,
+//    同一P队列中的其它协程和定时器照常运行, 不必等它返回
+// 2. 阻塞的协程返回后能在其它M上继续执行到结束
+// 3. 多个协程同时阻塞时并行等待, 总耗时接近单次阻塞的时间
+// 4. 没有被转交时 (短阻塞) 的额外开销
+
+#define MS 1000000LL
+#define NUM_SHORT 8
+#define BLOCK_MS 200
+#define NUM_BLOCKERS 4
+#define PAR_BLOCK_MS 50
+#define FAST_LOOPS 100000
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long start_ns;
+static atomic_llong short_done_ns = 0;
+static atomic_int short_done = 0;
+static long long sleeper_ns = 0;
+static long long blocker_ns = 0;
+
+void short_task(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 10; i++) {
+        co_yield();
+    }
+    atomic_fetch_add(&short_done, 1);
+    atomic_store(&short_done_ns, now_ns() - start_ns);
+}
+
+void sleeper(void *arg) {
+    (void)arg;
+    co_sleep(10 * MS);
+    sleeper_ns = now_ns() - start_ns;
+}
+
+void blocker(void *arg) {
+    int ms = (int)(long)arg;
+    co_enter_blocking();
+    usleep(ms * 1000);
+    co_exit_blocking();
+    co_yield();  // 返回后仍能正常调度
+    blocker_ns = now_ns() - start_ns;
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 阻塞调用转交P测试 ===\n");
+    co_set_gomaxprocs(1);
+
+    // 1/2. 单个P
+    start_ns = now_ns();
+    struct co *b = co_start("blocker", blocker, (void *)(long)BLOCK_MS);
+    co_yield();  // 让blocker先进入阻塞
+    struct co *shorts[NUM_SHORT];
+    for (int i = 0; i < NUM_SHORT; i++) {
+        shorts[i] = co_start("short", short_task, NULL);
+    }
+    struct co *s = co_start("sleeper", sleeper, NULL);
+    for (int i = 0; i < NUM_SHORT; i++) {
+        co_wait(shorts[i]);
+        co_release(shorts[i]);
+    }
+    co_wait(s);
+    co_release(s);
+    long long others_ns = now_ns() - start_ns;
+    co_wait(b);
+    co_release(b);
+    struct co_sched_stats stats;
+    co_get_sched_stats(&stats);
+    printf("单个P: 其它协程 %d 个在 %.1fms 完成, 定时器 %.1fms, 阻塞协程 %.1fms 结束, 转交 %lu 次\n",
+           atomic_load(&short_done), others_ns / 1e6, sleeper_ns / 1e6, blocker_ns / 1e6,
+           stats.syscall_handoffs);
+    int single_ok = atomic_load(&short_done) == NUM_SHORT && others_ns < BLOCK_MS / 2 * MS &&
+                    blocker_ns >= BLOCK_MS * MS && stats.syscall_handoffs > 0;
+
+    // 3. 多个阻塞协程
+    co_set_gomaxprocs(2);
+    co_thread(idle_thread, NULL);
+    start_ns = now_ns();
+    struct co *blockers[NUM_BLOCKERS];
+    for (int i = 0; i < NUM_BLOCKERS; i++) {
+        blockers[i] = co_start("blocker", blocker, (void *)(long)PAR_BLOCK_MS);
+    }
+    for (int i = 0; i < NUM_BLOCKERS; i++) {
+        co_wait(blockers[i]);
+        co_release(blockers[i]);
+    }
+    long long par_ns = now_ns() - start_ns;
+    printf("并行阻塞: %d 个协程各阻塞 %dms, 共 %.1fms\n", NUM_BLOCKERS, PAR_BLOCK_MS, par_ns / 1e6);
+    int par_ok = par_ns < (long long)NUM_BLOCKERS * PAR_BLOCK_MS * MS * 3 / 4;
+
+    // 4. 快速路径
+    long long t0 = now_ns();
+    for (int i = 0; i < FAST_LOOPS; i++) {
+        syscall(SYS_getpid);
+    }
+    long long t1 = now_ns();
+    for (int i = 0; i < FAST_LOOPS; i++) {
+        co_enter_blocking();
+        syscall(SYS_getpid);
+        co_exit_blocking();
+    }
+    long long t2 = now_ns();
+    printf("快速路径: getpid %.1fns, 加上enter/exit %.1fns\n",
+           (double)(t1 - t0) / FAST_LOOPS, (double)(t2 - t1) / FAST_LOOPS);
+
+    if (single_ok && par_ok) {
+        printf("阻塞调用转交P测试 PASSED\n");
+        return 0;
+    }
+    printf("阻塞调用转交P测试 FAILED\n");
+    return 1;
+}
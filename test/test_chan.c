@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// 通道测试:
+// 1. 无缓冲通道: 多个M上的生产者/消费者, 每个值恰好收到一次
+// 2. 有缓冲通道: 关闭后消费者取完剩余元素再结束; 单个生产者发送的顺序保持不变
+// 3. 关闭: 挂起的接收方被唤醒返回0, 向已关闭的通道发送返回EPIPE
+// 4. co_select: 同时从多个通道接收, 关闭的通道置为NULL后继续等待其它通道
+// 5. co_select的发送case、非阻塞select
+// 6. 共享栈协程之间通过通道和select来回传递栈上的数据
+
+#define NUM_THREADS 3
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define ITEMS 4000
+#define CAP 16
+#define NUM_SOURCES 3
+#define PER_SOURCE 1000
+
+static struct co_chan *unbuffered;
+static atomic_long unbuf_sum = 0;
+static atomic_int unbuf_count = 0;
+
+void unbuf_producer(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = id; i < ITEMS; i += NUM_PRODUCERS) {
+        long v = i + 1;
+        co_chan_send(unbuffered, &v);
+    }
+}
+
+void unbuf_consumer(void *arg) {
+    (void)arg;
+    long v;
+    while (co_chan_recv(unbuffered, &v)) {
+        atomic_fetch_add(&unbuf_sum, v);
+        atomic_fetch_add(&unbuf_count, 1);
+    }
+}
+
+static struct co_chan *buffered;
+static atomic_int order_errors = 0;
+static atomic_int buf_count = 0;
+
+struct msg {
+    int producer;
+    int seq;
+    char text[24];
+};
+
+void buf_producer(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < ITEMS / NUM_PRODUCERS; i++) {
+        struct msg m = { id, i, {0} };
+        snprintf(m.text, sizeof(m.text), "libco-%d-%d", id, i);
+        co_chan_send(buffered, &m);
+    }
+}
+
+// 只有一个消费者, 检查每个生产者的消息按发送顺序到达
+void buf_consumer(void *arg) {
+    (void)arg;
+    int next_seq[NUM_PRODUCERS] = {0};
+    struct msg m;
+    while (co_chan_recv(buffered, &m)) {
+        char expect[24];
+        snprintf(expect, sizeof(expect), "libco-%d-%d", m.producer, m.seq);
+        if (m.seq != next_seq[m.producer] || strcmp(m.text, expect) != 0) {
+            atomic_fetch_add(&order_errors, 1);
+        }
+        next_seq[m.producer] = m.seq + 1;
+        atomic_fetch_add(&buf_count, 1);
+    }
+}
+
+static struct co_chan *closing;
+static atomic_int close_woken = 0;
+
+void close_waiter(void *arg) {
+    (void)arg;
+    int v = 42;
+    if (co_chan_recv(closing, &v) == 0 && v == 0) {
+        atomic_fetch_add(&close_woken, 1);
+    }
+}
+
+static struct co_chan *sources[NUM_SOURCES];
+static int selected[NUM_SOURCES];
+static long select_sum = 0;
+
+void source(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < PER_SOURCE; i++) {
+        int v = id * PER_SOURCE + i;
+        co_chan_send(sources[id], &v);
+    }
+    co_chan_close(sources[id]);
+}
+
+void selector(void *arg) {
+    (void)arg;
+    int vals[NUM_SOURCES];
+    struct co_select_case cases[NUM_SOURCES];
+    for (int i = 0; i < NUM_SOURCES; i++) {
+        cases[i].chan = sources[i];
+        cases[i].op = CO_CHAN_RECV;
+        cases[i].elem = &vals[i];
+    }
+    int open = NUM_SOURCES;
+    while (open > 0) {
+        int i = co_select(cases, NUM_SOURCES, 1);
+        if (!cases[i].ok) {
+            cases[i].chan = NULL;
+            open--;
+            continue;
+        }
+        selected[i]++;
+        select_sum += vals[i];
+    }
+}
+
+static struct co_chan *out;
+
+void drain(void *arg) {
+    (void)arg;
+    int v;
+    while (co_chan_recv(out, &v)) {
+    }
+}
+
+#define PINGS 500
+static struct co_chan *ping, *pong;
+static atomic_int pong_errors = 0;
+
+void pinger(void *arg) {
+    (void)arg;
+    for (int i = 0; i < PINGS; i++) {
+        int v = i, back = -1;
+        co_chan_send(ping, &v);
+        co_chan_recv(pong, &back);
+        if (back != 2 * i) atomic_fetch_add(&pong_errors, 1);
+    }
+    co_chan_close(ping);
+}
+
+void ponger(void *arg) {
+    (void)arg;
+    int v;
+    struct co_select_case c = { ping, CO_CHAN_RECV, &v, 0 };
+    while (co_select(&c, 1, 1) == 0 && c.ok) {
+        int back = 2 * v;
+        co_chan_send(pong, &back);
+    }
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 通道测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    // 1. 无缓冲
+    unbuffered = co_chan_new(sizeof(long), 0);
+    struct co *prods[NUM_PRODUCERS], *cons[NUM_CONSUMERS];
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        cons[i] = co_start("consumer", unbuf_consumer, NULL);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        prods[i] = co_start("producer", unbuf_producer, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        co_wait(prods[i]);
+        co_release(prods[i]);
+    }
+    co_chan_close(unbuffered);
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        co_wait(cons[i]);
+        co_release(cons[i]);
+    }
+    co_chan_free(unbuffered);
+    long expected = (long)ITEMS * (ITEMS + 1) / 2;
+    printf("无缓冲: 收到 %d / %d, 总和 %ld / %ld\n", atomic_load(&unbuf_count), ITEMS,
+           atomic_load(&unbuf_sum), expected);
+    int unbuf_ok = atomic_load(&unbuf_count) == ITEMS && atomic_load(&unbuf_sum) == expected;
+
+    // 2. 有缓冲
+    buffered = co_chan_new(sizeof(struct msg), CAP);
+    struct co *consumer = co_start("consumer", buf_consumer, NULL);
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        prods[i] = co_start("producer", buf_producer, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        co_wait(prods[i]);
+        co_release(prods[i]);
+    }
+    co_chan_close(buffered);
+    co_wait(consumer);
+    co_release(consumer);
+    co_chan_free(buffered);
+    printf("有缓冲: 收到 %d / %d, 乱序 %d\n", atomic_load(&buf_count), ITEMS,
+           atomic_load(&order_errors));
+    int buf_ok = atomic_load(&buf_count) == ITEMS && atomic_load(&order_errors) == 0;
+
+    // 3. 关闭
+    closing = co_chan_new(sizeof(int), 0);
+    struct co *waiters[4];
+    for (int i = 0; i < 4; i++) {
+        waiters[i] = co_start("close_waiter", close_waiter, NULL);
+    }
+    co_sleep(5000000);  // 让接收方都挂起
+    co_chan_close(closing);
+    for (int i = 0; i < 4; i++) {
+        co_wait(waiters[i]);
+        co_release(waiters[i]);
+    }
+    int v = 1;
+    errno = 0;
+    int send_ret = co_chan_send(closing, &v);
+    int send_errno = errno;
+    co_chan_free(closing);
+    printf("关闭: 唤醒 %d / 4, 向已关闭通道发送返回 %d (%s)\n", atomic_load(&close_woken),
+           send_ret, send_errno == EPIPE ? "EPIPE" : "?");
+    int close_ok = atomic_load(&close_woken) == 4 && send_ret == -1 && send_errno == EPIPE;
+
+    // 4. select接收
+    for (int i = 0; i < NUM_SOURCES; i++) {
+        sources[i] = co_chan_new(sizeof(int), i);  // 容量0、1、2
+    }
+    struct co *sel = co_start("selector", selector, NULL);
+    struct co *srcs[NUM_SOURCES];
+    for (int i = 0; i < NUM_SOURCES; i++) {
+        srcs[i] = co_start("source", source, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_SOURCES; i++) {
+        co_wait(srcs[i]);
+        co_release(srcs[i]);
+    }
+    co_wait(sel);
+    co_release(sel);
+    long select_expected = (long)NUM_SOURCES * PER_SOURCE * (NUM_SOURCES * PER_SOURCE - 1) / 2;
+    printf("select: 各通道收到 %d/%d/%d, 总和 %ld / %ld\n", selected[0], selected[1], selected[2],
+           select_sum, select_expected);
+    int select_ok = select_sum == select_expected;
+    for (int i = 0; i < NUM_SOURCES; i++) {
+        select_ok = select_ok && selected[i] == PER_SOURCE;
+        co_chan_free(sources[i]);
+    }
+
+    // 5. 非阻塞select与发送case
+    struct co_chan *in = co_chan_new(sizeof(int), 1);
+    out = co_chan_new(sizeof(int), 0);
+    int got = 0, put = 7;
+    struct co_select_case cases[2] = {
+        { in, CO_CHAN_RECV, &got, 0 },
+        { out, CO_CHAN_SEND, &put, 0 },
+    };
+    int idle = co_select(cases, 2, 0);  // in为空, out没有接收方
+    struct co *d = co_start("drain", drain, NULL);
+    int chosen = co_select(cases, 2, 1);  // 等到drain开始接收
+    int nil_cases = co_select((struct co_select_case[]){ { NULL, CO_CHAN_RECV, &got, 0 } }, 1, 1);
+    co_chan_close(out);
+    co_wait(d);
+    co_release(d);
+    co_chan_free(in);
+    co_chan_free(out);
+    printf("非阻塞select返回 %d, 阻塞select选中 %d (ok=%d), 全部为NULL返回 %d\n",
+           idle, chosen, cases[1].ok, nil_cases);
+    int misc_ok = idle == -1 && chosen == 1 && cases[1].ok == 1 && nil_cases == -1;
+
+    // 6. 共享栈
+    ping = co_chan_new(sizeof(int), 0);
+    pong = co_chan_new(sizeof(int), 0);
+    struct co_attr attr = { .name = "pinger", .stack_size = 0, .flags = CO_ATTR_SHARED_STACK };
+    struct co *pi = co_start_attr(&attr, pinger, NULL);
+    attr.name = "ponger";
+    struct co *po = co_start_attr(&attr, ponger, NULL);
+    co_wait(pi);
+    co_wait(po);
+    co_release(pi);
+    co_release(po);
+    co_chan_free(ping);
+    co_chan_free(pong);
+    printf("共享栈: %d 次往返, 错误 %d\n", PINGS, atomic_load(&pong_errors));
+    int shared_ok = atomic_load(&pong_errors) == 0;
+
+    if (unbuf_ok && buf_ok && close_ok && select_ok && misc_ok && shared_ok) {
+        printf("通道测试 PASSED\n");
+        return 0;
+    }
+    printf("通道测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "co.h"
+
+// 运行期回收测试: 多个M上反复创建、等待并释放大量短生命周期协程,
+// 控制块在P之间流转 (在一个P上创建, 在另一个P上结束), 常驻内存应保持平稳
+
+#define NUM_THREADS 3
+#define ROUNDS 200
+#define WARMUP 20
+#define BATCH 500
+
+static atomic_int finished = 0;
+
+void short_work(void *arg) {
+    (void)arg;
+    co_yield();
+    atomic_fetch_add(&finished, 1);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+static long rss_kb() {
+    long size = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main() {
+    printf("=== 运行期回收测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    struct co_attr detached = { .name = "detached", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+    static struct co *cos[BATCH];
+    long warm_rss = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        if (r == WARMUP) warm_rss = rss_kb();
+
+        int target = atomic_load(&finished) + BATCH;
+        for (int i = 0; i < BATCH; i++) {
+            if (i % 2) {
+                cos[i] = co_start("joined", short_work, NULL);
+            } else {
+                cos[i] = NULL;
+                co_start_attr(&detached, short_work, NULL);
+            }
+        }
+        for (int i = 0; i < BATCH; i++) {
+            if (cos[i]) {
+                co_wait(cos[i]);
+                co_release(cos[i]);
+            }
+        }
+        while (atomic_load(&finished) < target) {
+            co_yield();
+        }
+    }
+    long final_rss = rss_kb();
+
+    printf("完成协程: %d, 预热后RSS: %ldKB, 结束时RSS: %ldKB\n",
+           atomic_load(&finished), warm_rss, final_rss);
+    if (atomic_load(&finished) == ROUNDS * BATCH && final_rss - warm_rss < 1024) {
+        printf("运行期回收测试 PASSED\n");
+        return 0;
+    }
+    printf("运行期回收测试 FAILED\n");
+    return 1;
+}
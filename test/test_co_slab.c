@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stddef.h>
+#include "co.h"
+
+// 协程控制块回收测试: 预热之后, 反复创建短生命周期的协程 (分离的, 或co_wait后co_release的)
+// 不应再有任何堆分配
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int counting = 0;
+static long heap_calls = 0;
+
+void *malloc(size_t size) {
+    if (counting) heap_calls++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    if (counting) heap_calls++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (counting) heap_calls++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+#define ROUNDS 50
+#define BATCH 100
+
+static int finished = 0;
+
+void short_work(void *arg) {
+    (void)arg;
+    co_yield();
+    finished++;
+}
+
+// 分离的协程: 结束后控制块立即回收
+static void run_detached() {
+    struct co_attr attr = { .name = "a-rather-long-coroutine-name-that-gets-truncated", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+    for (int r = 0; r < ROUNDS; r++) {
+        int target = finished + BATCH;
+        for (int i = 0; i < BATCH; i++) {
+            co_start_attr(&attr, short_work, NULL);
+        }
+        while (finished < target) {
+            co_yield();
+        }
+    }
+}
+
+// 等待后释放句柄
+static void run_joined() {
+    for (int r = 0; r < ROUNDS; r++) {
+        struct co *cos[BATCH];
+        for (int i = 0; i < BATCH; i++) {
+            cos[i] = co_start("joined", short_work, NULL);
+        }
+        for (int i = 0; i < BATCH; i++) {
+            co_wait(cos[i]);
+            co_release(cos[i]);
+        }
+    }
+}
+
+int main() {
+    printf("=== 协程控制块回收测试 ===\n");
+    co_set_gomaxprocs(1);  // 按需启动的M会分配自己的P
+
+    // 预热: 分配slab和栈缓存
+    run_detached();
+    run_joined();
+
+    counting = 1;
+    run_detached();
+    long detached_calls = heap_calls;
+    heap_calls = 0;
+    run_joined();
+    long joined_calls = heap_calls;
+    counting = 0;
+
+    printf("完成协程: %d, 稳定状态堆分配: 分离 %ld 次, 等待后释放 %ld 次\n",
+           finished, detached_calls, joined_calls);
+    if (finished == 4 * ROUNDS * BATCH && detached_calls == 0 && joined_calls == 0) {
+        printf("协程控制块回收测试 PASSED\n");
+        return 0;
+    }
+    printf("协程控制块回收测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "deque.h"
+
+// Chase-Lev 队列压力测试: 一个所有者线程放入/取出, 多个窃取线程并发偷取,
+// 检查每个元素恰好被取走一次 (没有丢失也没有重复)
+
+#define NUM_ITEMS 1000000
+#define NUM_THIEVES 3
+#define CAPACITY 64
+
+static struct deque dq;
+static atomic_int taken[NUM_ITEMS];
+static atomic_int owner_done = 0;
+static atomic_long total_taken = 0;
+
+static void take(void *data) {
+    long item = (long)data - 1;  // 元素加1存放, 避免与空队列的NULL混淆
+    atomic_fetch_add(&taken[item], 1);
+    atomic_fetch_add(&total_taken, 1);
+}
+
+static void* thief(void *arg) {
+    (void)arg;
+    while (1) {
+        void *data = deque_steal(&dq);
+        if (data) {
+            take(data);
+        } else if (atomic_load(&owner_done) && deque_size(&dq) == 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    printf("=== Chase-Lev 队列压力测试 ===\n");
+    deque_init(&dq, CAPACITY);
+
+    pthread_t thieves[NUM_THIEVES];
+    for (int i = 0; i < NUM_THIEVES; i++) {
+        pthread_create(&thieves[i], NULL, thief, NULL);
+    }
+
+    long next = 0;
+    while (next < NUM_ITEMS) {
+        // 队列满或每放入3个时, 所有者自己取出一个
+        if (!deque_push(&dq, (void *)(next + 1))) {
+            void *data = deque_pop(&dq);
+            if (data) take(data);
+            continue;
+        }
+        next++;
+        if (next % 3 == 0) {
+            void *data = deque_pop(&dq);
+            if (data) take(data);
+        }
+    }
+    void *data;
+    while ((data = deque_pop(&dq)) != NULL) {
+        take(data);
+    }
+    atomic_store(&owner_done, 1);
+
+    for (int i = 0; i < NUM_THIEVES; i++) {
+        pthread_join(thieves[i], NULL);
+    }
+
+    int lost = 0, duplicated = 0;
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        int n = atomic_load(&taken[i]);
+        if (n == 0) lost++;
+        if (n > 1) duplicated++;
+    }
+    deque_destroy(&dq);
+
+    printf("取走元素: %ld, 丢失: %d, 重复: %d\n", atomic_load(&total_taken), lost, duplicated);
+    if (lost == 0 && duplicated == 0) {
+        printf("Chase-Lev 队列压力测试 PASSED\n");
+        return 0;
+    }
+    printf("Chase-Lev 队列压力测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include "co.h"
+
+// 全局队列公平性测试: 单个M上创建远多于本地队列容量的协程, 溢出的协程进入全局队列。
+// 已在本地队列中的协程不断yield, 直到所有协程都至少运行过一次;
+// 如果调度器只在本地队列为空时才检查全局队列, 全局队列中的协程会被饿死。
+
+#define NUM_COROUTINES 1000
+#define MAX_YIELDS 1000
+
+static int started = 0;
+static int starved = 0;
+
+void spin(void *arg) {
+    (void)arg;
+    started++;
+    int yields = 0;
+    while (started < NUM_COROUTINES) {
+        if (++yields > MAX_YIELDS) {
+            starved++;
+            break;
+        }
+        co_yield();
+    }
+}
+
+int main() {
+    printf("=== 全局队列公平性测试 ===\n");
+    co_set_gomaxprocs(1);  // 单个M
+
+    struct co *cos[NUM_COROUTINES];
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        cos[i] = co_start("spin", spin, NULL);
+    }
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        co_wait(cos[i]);
+    }
+
+    printf("启动协程: %d, 等待超时: %d\n", started, starved);
+    if (started == NUM_COROUTINES && starved == 0) {
+        printf("全局队列公平性测试 PASSED\n");
+        return 0;
+    }
+    printf("全局队列公平性测试 FAILED\n");
+    return 1;
+}
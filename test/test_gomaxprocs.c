@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// GOMAXPROCS与按需启动的工作M测试 (不调用co_thread):
+// 1. 只调用co_start的程序在多个线程上运行, 工作M是按需启动的
+// 2. 缩小GOMAXPROCS后新的协程只在剩下的P上运行
+// 3. 再扩大时重新启用停下的P, 不再创建新的M
+// 4. 协程运行期间缩小到1: 停下的P交出队列, 之后所有协程都在同一个线程上运行, 没有协程丢失
+// 5. 同4, 但使用CO_SCHED_FAIR且停下的P上还有共享栈协程: 共享栈协程留下, 其它协程仍然立即交出。
+//    共享栈协程属于NORMAL类, 交出队列时总是先取到它; 其它协程属于LATENCY类, 停下的P没有交出的话会一直运行它们
+
+#define MS 1000000LL
+#define NUM_WORKERS 16
+#define ROUNDS 10
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void spin(long long ns) {
+    long long end = now_ns() + ns;
+    while (now_ns() < end) {
+    }
+}
+
+// 运行过协程的线程
+static struct co_mutex seen_mutex = {0};
+static pthread_t seen[64];
+static int num_seen = 0;
+
+static void see_thread() {
+    pthread_t self = pthread_self();
+    co_mutex_lock(&seen_mutex);
+    int found = 0;
+    for (int i = 0; i < num_seen; i++) {
+        if (pthread_equal(seen[i], self)) found = 1;
+    }
+    if (!found && num_seen < 64) {
+        seen[num_seen++] = self;
+    }
+    co_mutex_unlock(&seen_mutex);
+}
+
+void worker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ROUNDS; i++) {
+        see_thread();
+        spin(MS);
+        co_yield();
+    }
+}
+
+// 运行一批worker, 返回它们用到的线程数
+static int run_batch() {
+    num_seen = 0;
+    struct co *cos[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        cos[i] = co_start("worker", worker, NULL);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        co_wait(cos[i]);
+        co_release(cos[i]);
+    }
+    return num_seen;
+}
+
+static atomic_int measuring = 0;
+static atomic_int finished = 0;
+
+void looper(void *arg) {
+    (void)arg;
+    while (atomic_load(&measuring) == 0) {
+        spin(MS / 4);
+        co_yield();
+    }
+    for (int i = 0; i < ROUNDS; i++) {
+        see_thread();
+        co_yield();
+    }
+    atomic_fetch_add(&finished, 1);
+}
+
+// 在其它线程上创建共享栈协程 (留在该线程的P上) 和一批looper, 让looper进入该P的private队列后缩小到1
+static pthread_t main_thread;
+static atomic_int stop_fair = 0;
+static atomic_int shrunk = 0;
+static atomic_int stray_runs = 0;  // 缩小之后looper在其它线程上运行的次数
+static struct co *fair_cos[NUM_WORKERS];
+
+void shared_looper(void *arg) {
+    (void)arg;
+    while (atomic_load(&stop_fair) == 0) {
+        spin(MS / 4);
+        co_yield();
+    }
+}
+
+void fair_looper(void *arg) {
+    (void)arg;
+    while (atomic_load(&stop_fair) == 0) {
+        if (atomic_load(&shrunk) && !pthread_equal(pthread_self(), main_thread)) {
+            atomic_fetch_add(&stray_runs, 1);
+        }
+        spin(MS / 4);
+        co_yield();
+    }
+}
+
+void spawner(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 10000 && pthread_equal(pthread_self(), main_thread); i++) {
+        spin(MS / 10);
+        co_yield();
+    }
+    if (pthread_equal(pthread_self(), main_thread)) {
+        return;
+    }
+    struct co_attr attr = { .name = "shared", .flags = CO_ATTR_SHARED_STACK | CO_ATTR_DETACHED };
+    co_start_attr(&attr, shared_looper, NULL);
+    struct co_attr lat = { .name = "looper", .sched_class = CO_CLASS_LATENCY };
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        fair_cos[i] = co_start_attr(&lat, fair_looper, NULL);
+    }
+    co_yield();  // 本P选择下一个协程时把public队列移入private队列
+    co_set_gomaxprocs(1);
+    atomic_store(&shrunk, 1);
+}
+
+int main() {
+    printf("=== GOMAXPROCS与工作M测试 ===\n");
+    main_thread = pthread_self();
+    struct co_sched_stats stats;
+
+    // 1. 按需启动
+    co_set_gomaxprocs(4);
+    int threads1 = run_batch();
+    co_get_sched_stats(&stats);
+    unsigned long started1 = stats.workers_started;
+    printf("GOMAXPROCS=4: 用到 %d 个线程, 按需启动 %lu 个M\n", threads1, started1);
+    int grow_ok = threads1 >= 2 && started1 >= 1 && started1 <= 3;
+
+    // 2. 缩小
+    co_set_gomaxprocs(2);
+    int threads2 = run_batch();
+    printf("GOMAXPROCS=2: 用到 %d 个线程\n", threads2);
+    int shrink_ok = threads2 <= 2;
+
+    // 3. 再扩大
+    co_set_gomaxprocs(4);
+    int threads3 = run_batch();
+    co_get_sched_stats(&stats);
+    printf("GOMAXPROCS=4: 用到 %d 个线程, 共启动 %lu 个M\n", threads3, stats.workers_started);
+    int regrow_ok = threads3 >= 3 && stats.workers_started <= 3;
+
+    // 4. 运行中缩小到1
+    struct co *cos[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        cos[i] = co_start("looper", looper, NULL);
+    }
+    co_sleep(10 * MS);
+    co_set_gomaxprocs(1);
+    co_sleep(20 * MS);  // 停下的P上的协程在下一次让出时离开
+    num_seen = 0;
+    atomic_store(&measuring, 1);
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        co_wait(cos[i]);
+        co_release(cos[i]);
+    }
+    printf("运行中缩小到1: 完成 %d / %d, 之后用到 %d 个线程\n", atomic_load(&finished),
+           NUM_WORKERS, num_seen);
+    int busy_ok = atomic_load(&finished) == NUM_WORKERS && num_seen == 1;
+
+    // 5. CO_SCHED_FAIR下带共享栈协程缩小到1
+    co_set_gomaxprocs(4);
+    co_set_sched_policy(CO_SCHED_FAIR);
+    struct co *s = co_start("spawner", spawner, NULL);
+    co_wait(s);
+    co_release(s);
+    int fair_ok = 0;
+    if (atomic_load(&shrunk)) {
+        co_sleep(30 * MS);
+        atomic_store(&stop_fair, 1);
+        for (int i = 0; i < NUM_WORKERS; i++) {
+            co_wait(fair_cos[i]);
+            co_release(fair_cos[i]);
+        }
+        // 缩小时正在其它P上运行的looper让出前还会被计一次, 每个P最多一个
+        printf("FAIR下带共享栈协程缩小到1: 之后在其它线程上运行 %d 次\n", atomic_load(&stray_runs));
+        fair_ok = atomic_load(&stray_runs) < 4;
+    } else {
+        printf("FAIR下带共享栈协程缩小到1: spawner没有被其它线程运行\n");
+    }
+
+    if (grow_ok && shrink_ok && regrow_ok && busy_ok && fair_ok) {
+        printf("GOMAXPROCS与工作M测试 PASSED\n");
+        return 0;
+    }
+    printf("GOMAXPROCS与工作M测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "co.h"
+
+// 空闲M休眠测试: 没有工作时工作线程应当休眠而不是自旋消耗CPU,
+// 有新工作时被唤醒并参与执行
+
+#define NUM_THREADS 3
+#define NUM_COROUTINES 64
+#define YIELDS 5
+
+static pthread_t runners[NUM_COROUTINES * (YIELDS + 1)];
+static atomic_int num_runs = 0;
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+void work(void *arg) {
+    (void)arg;
+    for (int i = 0; i <= YIELDS; i++) {
+        volatile long sum = 0;
+        for (long j = 0; j < 200000; j++) {
+            sum += j;
+        }
+        runners[atomic_fetch_add(&num_runs, 1)] = pthread_self();
+        if (i < YIELDS) co_yield();
+    }
+}
+
+static long cpu_time_us() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000L + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+int main() {
+    printf("=== 空闲M休眠测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    // 等待工作线程进入休眠, 之后的空闲期间几乎不应消耗CPU
+    usleep(100000);
+    long cpu_before = cpu_time_us();
+    usleep(200000);
+    long idle_cpu = cpu_time_us() - cpu_before;
+
+    struct co_sched_stats idle_stats;
+    co_get_sched_stats(&idle_stats);
+
+    struct co *cos[NUM_COROUTINES];
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        cos[i] = co_start("park", work, NULL);
+    }
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        co_wait(cos[i]);
+    }
+
+    struct co_sched_stats stats;
+    co_get_sched_stats(&stats);
+
+    int threads = 0;
+    pthread_t seen[NUM_THREADS + 1];
+    for (int i = 0; i < atomic_load(&num_runs); i++) {
+        int found = 0;
+        for (int j = 0; j < threads; j++) {
+            if (pthread_equal(seen[j], runners[i])) found = 1;
+        }
+        if (!found && threads < NUM_THREADS + 1) seen[threads++] = runners[i];
+    }
+
+    printf("空闲期间CPU时间: %ldus, 休眠次数: %lu\n", idle_cpu, idle_stats.parks);
+    printf("唤醒次数: %lu, 无效唤醒: %lu, 平均唤醒延迟: %luns, 最大唤醒延迟: %luns\n",
+           stats.wakeups, stats.spurious_wakeups, stats.wake_latency_avg_ns, stats.wake_latency_max_ns);
+    printf("参与执行的线程数: %d\n", threads);
+
+    if (idle_stats.parks >= NUM_THREADS && idle_cpu < 20000 &&
+        stats.wakeups > 0 && threads > 1 &&
+        atomic_load(&num_runs) == NUM_COROUTINES * (YIELDS + 1)) {
+        printf("空闲M休眠测试 PASSED\n");
+        return 0;
+    }
+    printf("空闲M休眠测试 FAILED\n");
+    return 1;
+}
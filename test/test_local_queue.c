@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include "co.h"
+
+// 本地队列容量测试: 单个M上同时存在远多于本地队列容量的可运行协程,
+// 溢出部分批量进入全局队列, 检查每个协程都被调度并完成所有步骤
+
+#define NUM_COROUTINES 2000
+#define YIELDS 10
+
+static int steps[NUM_COROUTINES];
+static int finished = 0;
+
+void work(void *arg) {
+    int *s = (int *)arg;
+    for (int i = 0; i < YIELDS; i++) {
+        (*s)++;
+        co_yield();
+    }
+    finished++;
+}
+
+int main() {
+    printf("=== 本地队列容量测试 ===\n");
+    co_set_gomaxprocs(1);  // 单个M
+
+    struct co *cos[NUM_COROUTINES];
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        cos[i] = co_start("runq", work, &steps[i]);
+    }
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        co_wait(cos[i]);
+    }
+
+    int wrong = 0;
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        if (steps[i] != YIELDS) wrong++;
+    }
+
+    printf("完成协程: %d, 步数异常: %d\n", finished, wrong);
+    if (finished == NUM_COROUTINES && wrong == 0) {
+        printf("本地队列容量测试 PASSED\n");
+        return 0;
+    }
+    printf("本地队列容量测试 FAILED\n");
+    return 1;
+}
@@ -19,7 +19,7 @@ struct test_data {
 
 // 全局计数器（测试竞争条件）
 static volatile int global_counter = 0;
-static pthread_mutex_t counter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct co_mutex counter_mutex = {0};
 
 // 获取当前时间（毫秒）
 long long get_current_time_ms() {
@@ -57,7 +57,7 @@ void io_work(void *arg) {
     
     for (int i = 0; i < WORK_ITERATIONS; i++) {
         // 模拟I/O等待
-        usleep(5000); // 5ms
+        co_sleep(5000000); // 5ms
         
         printf("[T%d] 协程 %s 完成I/O %d/%d\n", 
                data->thread_id, data->name, i+1, WORK_ITERATIONS);
@@ -81,15 +81,15 @@ void mixed_work(void *arg) {
         }
         
         // 更新全局计数器
-        pthread_mutex_lock(&counter_mutex);
+        co_mutex_lock(&counter_mutex);
         int old_value = global_counter;
         global_counter++;
-        pthread_mutex_unlock(&counter_mutex);
+        co_mutex_unlock(&counter_mutex);
         
         printf("[T%d] 协程 %s 混合工作 %d/%d: 计数器 %d -> %d\n", 
                data->thread_id, data->name, i+1, WORK_ITERATIONS, old_value, old_value+1);
         
-        usleep(3000); // 3ms
+        co_sleep(3000000); // 3ms
         co_yield();
     }
     
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "co.h"
+
+// 网络轮询测试:
+// 1. 协程在co_read上挂起时, 同一M上的其它协程继续运行
+// 2. 回环TCP上的echo: co_accept/co_connect/co_write/co_read, 多个M并发
+
+#define NUM_THREADS 2
+#define NUM_CLIENTS 16
+#define MESSAGES 50
+#define TICKS 100
+
+static int pair[2];
+static atomic_int ticks = 0;
+static char received[16];
+static atomic_int ticks_at_read = -1;
+
+void reader(void *arg) {
+    (void)arg;
+    ssize_t n = co_read(pair[0], received, sizeof(received) - 1);
+    if (n > 0) received[n] = '\0';
+    atomic_store(&ticks_at_read, atomic_load(&ticks));
+}
+
+void ticker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < TICKS; i++) {
+        atomic_fetch_add(&ticks, 1);
+        co_yield();
+    }
+    co_write(pair[1], "hello", 5);
+}
+
+static int listen_fd;
+static struct sockaddr_in server_addr;
+static atomic_int echoed = 0;
+static atomic_int mismatched = 0;
+
+void echo_conn(void *arg) {
+    int fd = (int)(long)arg;
+    char buf[256];
+    ssize_t n;
+    while ((n = co_read(fd, buf, sizeof(buf))) > 0) {
+        co_write(fd, buf, n);
+    }
+    co_close(fd);
+}
+
+void acceptor(void *arg) {
+    (void)arg;
+    struct co_attr attr = { .name = "echo", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        int fd = co_accept(listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        co_start_attr(&attr, echo_conn, (void *)(long)fd);
+    }
+}
+
+void client(void *arg) {
+    int id = (int)(long)arg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (co_connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        atomic_fetch_add(&mismatched, 1);
+        co_close(fd);
+        return;
+    }
+    for (int i = 0; i < MESSAGES; i++) {
+        char msg[64], reply[64];
+        int len = snprintf(msg, sizeof(msg), "client %d message %d", id, i);
+        co_write(fd, msg, len);
+        int got = 0;
+        while (got < len) {
+            ssize_t n = co_read(fd, reply + got, len - got);
+            if (n <= 0) break;
+            got += n;
+        }
+        if (got != len || memcmp(msg, reply, len) != 0) {
+            atomic_fetch_add(&mismatched, 1);
+        } else {
+            atomic_fetch_add(&echoed, 1);
+        }
+    }
+    co_close(fd);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 网络轮询测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    // 1. 读挂起时其它协程继续运行
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+    struct co *r = co_start("reader", reader, NULL);
+    struct co *t = co_start("ticker", ticker, NULL);
+    co_wait(r);
+    co_wait(t);
+    co_close(pair[0]);
+    co_close(pair[1]);
+    int read_ok = strcmp(received, "hello") == 0 && atomic_load(&ticks_at_read) == TICKS;
+    printf("读取: \"%s\", 读取完成时ticker已运行 %d 次\n", received, atomic_load(&ticks_at_read));
+
+    // 2. 回环echo
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = 0;
+    bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
+    socklen_t len = sizeof(server_addr);
+    getsockname(listen_fd, (struct sockaddr *)&server_addr, &len);
+    listen(listen_fd, 128);
+
+    struct co *acc = co_start("acceptor", acceptor, NULL);
+    struct co *clients[NUM_CLIENTS];
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        clients[i] = co_start("client", client, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        co_wait(clients[i]);
+    }
+    co_wait(acc);
+    co_close(listen_fd);
+
+    printf("echo: 成功 %d, 失败 %d\n", atomic_load(&echoed), atomic_load(&mismatched));
+    if (read_ok && atomic_load(&echoed) == NUM_CLIENTS * MESSAGES && atomic_load(&mismatched) == 0) {
+        printf("网络轮询测试 PASSED\n");
+        return 0;
+    }
+    printf("网络轮询测试 FAILED\n");
+    return 1;
+}
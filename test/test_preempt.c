@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// 异步抢占测试 (只有一个P):
+// 1. 一个不调用co_yield的计算协程运行期间, 同一P上的短协程仍能在几个时间片内完成
+// 2. 以CO_ATTR_NO_PREEMPT创建的计算协程运行期间, 其它协程一次也得不到运行
+// 3. 关闭抢占后计算协程不再被打断
+
+#define MS 1000000LL
+#define SLICE_NS (1 * MS)
+#define HOG_MS 300
+#define NUM_SHORT 20
+#define SPIN_MS 50
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 不让出的计算循环, 最多运行ms毫秒或直到stop被设置
+static volatile int stop = 0;
+static void spin(long long ms) {
+    long long end = now_ns() + ms * MS;
+    while (!stop && now_ns() < end) {
+        for (volatile int i = 0; i < 1000; i++) {
+        }
+    }
+}
+
+void hog(void *arg) {
+    (void)arg;
+    spin(HOG_MS);
+}
+
+static long long created_ns[NUM_SHORT];
+static long long latency_ns[NUM_SHORT];
+
+void short_task(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < 3; i++) {
+        co_yield();
+    }
+    latency_ns[id] = now_ns() - created_ns[id];
+}
+
+// 不停让出的协程, ticks增加说明它得到了运行
+static atomic_int ticks = 0;
+static volatile int ticker_stop = 0;
+
+void ticker(void *arg) {
+    (void)arg;
+    while (!ticker_stop) {
+        atomic_fetch_add(&ticks, 1);
+        co_yield();
+    }
+}
+
+static int spin_ticks = -1;
+
+void spinner(void *arg) {
+    (void)arg;
+    int before = atomic_load(&ticks);
+    spin(SPIN_MS);
+    spin_ticks = atomic_load(&ticks) - before;
+}
+
+// 启动spinner并等待它结束, 返回它运行期间ticker运行的次数
+static int run_spinner(int flags) {
+    struct co_attr attr = { .name = "spinner", .stack_size = 0, .flags = flags };
+    ticker_stop = 0;
+    struct co *t = co_start("ticker", ticker, NULL);
+    co_yield();  // 让ticker开始运行
+    struct co *s = co_start_attr(&attr, spinner, NULL);
+    co_wait(s);
+    co_release(s);
+    ticker_stop = 1;
+    co_wait(t);
+    co_release(t);
+    return spin_ticks;
+}
+
+int main() {
+    printf("=== 异步抢占测试 ===\n");
+    co_set_gomaxprocs(1);
+    co_set_preempt(SLICE_NS);
+
+    // 1. 计算协程与短协程混合
+    long long start = now_ns();
+    struct co *h = co_start("hog", hog, NULL);
+    co_yield();  // 让hog先运行, 它被抢占后main才能继续创建短协程
+    struct co *shorts[NUM_SHORT];
+    for (int i = 0; i < NUM_SHORT; i++) {
+        created_ns[i] = now_ns();
+        shorts[i] = co_start("short", short_task, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_SHORT; i++) {
+        co_wait(shorts[i]);
+        co_release(shorts[i]);
+    }
+    long long shorts_done = now_ns() - start;
+    stop = 1;
+    co_wait(h);
+    co_release(h);
+    stop = 0;
+    long long max_latency = 0;
+    for (int i = 0; i < NUM_SHORT; i++) {
+        if (latency_ns[i] > max_latency) max_latency = latency_ns[i];
+    }
+    struct co_sched_stats stats;
+    co_get_sched_stats(&stats);
+    printf("混合负载: %d 个短协程在 %.1fms 内完成, 最大延迟 %.1fms, 抢占 %lu 次\n",
+           NUM_SHORT, shorts_done / 1e6, max_latency / 1e6, stats.preemptions);
+    int mixed_ok = shorts_done < HOG_MS / 2 * MS && max_latency < HOG_MS / 2 * MS &&
+                   stats.preemptions > 0;
+
+    // 2. 可被抢占与不可被抢占的计算协程
+    int preempted_ticks = run_spinner(0);
+    int pinned_ticks = run_spinner(CO_ATTR_NO_PREEMPT);
+    printf("计算协程运行 %dms 期间其它协程运行: 可抢占 %d 次, CO_ATTR_NO_PREEMPT %d 次\n",
+           SPIN_MS, preempted_ticks, pinned_ticks);
+    int attr_ok = preempted_ticks > 0 && pinned_ticks == 0;
+
+    // 3. 关闭抢占
+    co_set_preempt(0);
+    int off_ticks = run_spinner(0);
+    printf("关闭抢占后: %d 次\n", off_ticks);
+    int off_ok = off_ticks == 0;
+
+    if (mixed_ok && attr_ok && off_ok) {
+        printf("异步抢占测试 PASSED\n");
+        return 0;
+    }
+    printf("异步抢占测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <time.h>
+#include "co.h"
+
+// runnext测试 (单个P):
+// 1. 通道乒乓: 发送方唤醒的接收方在发送方挂起后立即运行, 中间没有其它协程运行
+// 2. 防饿死: 乒乓进行期间本地队列中不断co_yield的协程仍然得到运行
+// 3. co_wait: 目标结束后等待者立即运行
+// 4. 多个P时唤醒者之后一直计算: 被唤醒的协程由其它M从runnext偷走, 不用等唤醒者让出
+
+#define PINGS 2000
+#define NUM_YIELDERS 8
+
+static struct co_chan *ping, *pong;
+static long yields = 0;     // 所有yielder的运行次数
+static int stop = 0;
+static int direct = 0;      // 中间没有yielder运行的交接次数
+
+void yielder(void *arg) {
+    (void)arg;
+    while (!stop) {
+        yields++;
+        co_yield();
+    }
+}
+
+void pinger(void *arg) {
+    (void)arg;
+    for (int i = 0; i < PINGS; i++) {
+        long before = yields;
+        co_chan_send(ping, &before);
+        long after;
+        co_chan_recv(pong, &after);
+        if (yields == after) direct++;
+    }
+}
+
+void ponger(void *arg) {
+    (void)arg;
+    for (int i = 0; i < PINGS; i++) {
+        long before;
+        co_chan_recv(ping, &before);
+        if (yields == before) direct++;
+        long now = yields;
+        co_chan_send(pong, &now);
+    }
+}
+
+static long exit_yields = -1;
+
+#define COMPUTE_MS 200
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct co_sem sem;
+static long long woken_at = 0;
+
+void sem_waiter(void *arg) {
+    (void)arg;
+    co_sem_wait(&sem);
+    woken_at = now_ns();
+}
+
+void short_task(void *arg) {
+    (void)arg;
+    co_yield();
+    exit_yields = yields;
+}
+
+int main() {
+    printf("=== runnext测试 ===\n");
+    co_set_gomaxprocs(1);
+    ping = co_chan_new(sizeof(long), 0);
+    pong = co_chan_new(sizeof(long), 0);
+
+    struct co *ys[NUM_YIELDERS];
+    for (int i = 0; i < NUM_YIELDERS; i++) {
+        ys[i] = co_start("yielder", yielder, NULL);
+    }
+    struct co *a = co_start("pinger", pinger, NULL);
+    struct co *b = co_start("ponger", ponger, NULL);
+    long start_yields = yields;
+    co_wait(a);
+    co_wait(b);
+    co_release(a);
+    co_release(b);
+    long pp_yields = yields - start_yields;
+
+    // 1. 交接: 每RUNNEXT_MAX次有一次回到本地队列随机选择, 其余都应直接交接
+    printf("乒乓: %d 次交接中 %d 次直接运行被唤醒的协程\n", 2 * PINGS, direct);
+    int handoff_ok = direct >= 2 * PINGS * 3 / 4;
+
+    // 2. 防饿死
+    printf("乒乓期间其它协程运行了 %ld 次\n", pp_yields);
+    int starve_ok = pp_yields >= 2 * PINGS / 32;
+
+    // 3. co_wait
+    struct co *t = co_start("short", short_task, NULL);
+    co_wait(t);
+    long waited = yields;
+    co_release(t);
+    printf("co_wait: 目标结束时yielder计数 %ld, 等待者醒来时 %ld\n", exit_yields, waited);
+    int wait_ok = exit_yields == waited;
+
+    stop = 1;
+    for (int i = 0; i < NUM_YIELDERS; i++) {
+        co_wait(ys[i]);
+        co_release(ys[i]);
+    }
+    co_chan_free(ping);
+    co_chan_free(pong);
+
+    // 4. 唤醒后计算: main唤醒等待者后不让出 (没有开启抢占)
+    co_set_gomaxprocs(4);
+    co_sem_init(&sem, 0);
+    struct co *w = co_start("waiter", sem_waiter, NULL);
+    co_sleep(5 * 1000000ULL);  // 等待者先挂起
+    long long posted = now_ns();
+    co_sem_post(&sem);
+    while (now_ns() - posted < COMPUTE_MS * 1000000LL) {
+    }
+    long long delay = woken_at ? woken_at - posted : -1;
+    co_wait(w);
+    co_release(w);
+    printf("唤醒后计算%dms: 等待者在 %.1fms 后运行\n", COMPUTE_MS, delay / 1e6);
+    int steal_ok = delay >= 0 && delay < COMPUTE_MS * 1000000LL / 4;
+
+    if (handoff_ok && starve_ok && wait_ok && steal_ok) {
+        printf("runnext测试 PASSED\n");
+        return 0;
+    }
+    printf("runnext测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <time.h>
+#include "co.h"
+
+// 调度类与加权公平测试 (CO_SCHED_FAIR, 单个M):
+// 1. 同时就绪时 LATENCY 类先于 NORMAL 类先于 BACKGROUND 类运行
+// 2. 同一类中的CPU密集协程按权重分配运行时间
+// 3. LATENCY 类一直忙碌时 BACKGROUND 类仍能周期性地运行, 运行时间按类统计
+
+#define SPIN_US 100
+#define WEIGHT_LIGHT 100
+#define WEIGHT_HEAVY 300
+
+static long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void spin(int us) {
+    long long end = now_us() + us;
+    while (now_us() < end) {
+    }
+}
+
+static struct co *start(const char *name, int sched_class, int weight, void (*func)(void *), void *arg) {
+    struct co_attr attr = { .name = name, .sched_class = sched_class, .weight = weight };
+    return co_start_attr(&attr, func, arg);
+}
+
+// ---------- 1. 类的顺序 ----------
+
+static int order[9];
+static int order_len = 0;
+
+void record(void *arg) {
+    order[order_len++] = (int)(long)arg;
+}
+
+static int test_order() {
+    static const int classes[] = { CO_CLASS_BACKGROUND, CO_CLASS_NORMAL, CO_CLASS_LATENCY };
+    struct co *cos[9];
+    for (int i = 0; i < 9; i++) {
+        int c = classes[i % 3];
+        cos[i] = start("order", c, 0, record, (void *)(long)c);
+    }
+    for (int i = 0; i < 9; i++) {
+        co_wait(cos[i]);
+    }
+    static const int expect[] = { CO_CLASS_LATENCY, CO_CLASS_NORMAL, CO_CLASS_BACKGROUND };
+    int ok = order_len == 9;
+    for (int i = 0; i < order_len; i++) {
+        ok = ok && order[i] == expect[i / 3];
+    }
+    printf("类的运行顺序: %s\n", ok ? "LATENCY -> NORMAL -> BACKGROUND" : "错误");
+    return ok;
+}
+
+// ---------- 2. 权重 ----------
+
+static volatile int stop = 0;
+
+void spinner(void *arg) {
+    long *count = arg;
+    while (!stop) {
+        spin(SPIN_US);
+        (*count)++;
+        co_yield();
+    }
+}
+
+static int test_weight() {
+    long light = 0, heavy = 0;
+    stop = 0;
+    struct co *a = start("light", CO_CLASS_NORMAL, WEIGHT_LIGHT, spinner, &light);
+    struct co *b = start("heavy", CO_CLASS_NORMAL, WEIGHT_HEAVY, spinner, &heavy);
+    co_sleep(300 * 1000000ULL);
+    stop = 1;
+    co_wait(a);
+    co_wait(b);
+
+    double ratio = light ? (double)heavy / light : 0;
+    printf("权重 %d:%d 的运行次数: %ld:%ld, 比例 %.2f\n", WEIGHT_HEAVY, WEIGHT_LIGHT, heavy, light, ratio);
+    return ratio > 2.0 && ratio < 4.5;
+}
+
+// ---------- 3. 防饿死与按类统计 ----------
+
+void counter(void *arg) {
+    long *count = arg;
+    while (!stop) {
+        (*count)++;
+        co_yield();
+    }
+}
+
+static int test_starvation() {
+    struct co_class_stats before, after;
+    co_get_class_stats(&before);
+
+    long lat1 = 0, lat2 = 0, bg = 0;
+    stop = 0;
+    struct co *a = start("latency", CO_CLASS_LATENCY, 0, spinner, &lat1);
+    struct co *b = start("latency", CO_CLASS_LATENCY, 0, spinner, &lat2);
+    struct co *c = start("background", CO_CLASS_BACKGROUND, 0, counter, &bg);
+    co_sleep(200 * 1000000ULL);
+    stop = 1;
+    co_wait(a);
+    co_wait(b);
+    co_wait(c);
+
+    co_get_class_stats(&after);
+    unsigned long lat_ns = after.runtime_ns[CO_CLASS_LATENCY] - before.runtime_ns[CO_CLASS_LATENCY];
+    unsigned long bg_ns = after.runtime_ns[CO_CLASS_BACKGROUND] - before.runtime_ns[CO_CLASS_BACKGROUND];
+    unsigned long starved = after.starved_runs[CO_CLASS_BACKGROUND] - before.starved_runs[CO_CLASS_BACKGROUND];
+    printf("LATENCY运行 %ld 次 (%lu ms), BACKGROUND运行 %ld 次 (%lu us), 其中防饿死 %lu 次\n",
+           lat1 + lat2, lat_ns / 1000000, bg, bg_ns / 1000, starved);
+    // 200ms中每10ms至少运行一次, 留出余量
+    return bg >= 5 && starved >= 5 && lat1 + lat2 > 10 * bg && lat_ns > 100 * bg_ns;
+}
+
+int main() {
+    printf("=== 调度类与加权公平测试 ===\n");
+    co_set_gomaxprocs(1);  // 单个M
+    co_set_sched_policy(CO_SCHED_FAIR);
+
+    int order_ok = test_order();
+    int weight_ok = test_weight();
+    int starve_ok = test_starvation();
+
+    if (order_ok && weight_ok && starve_ok) {
+        printf("调度类与加权公平测试 PASSED\n");
+        return 0;
+    }
+    printf("调度类与加权公平测试 FAILED\n");
+    return 1;
+}
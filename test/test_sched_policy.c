@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include "co.h"
+
+// 调度策略测试 (单个P):
+// 1. FIFO: 不断co_yield的协程按创建顺序轮流运行
+// 2. LIFO: 最后创建的协程最先运行; fork-join二叉树深度优先, 同时存在的协程数与深度成正比
+// 3. PRIORITY: 按优先级从高到低运行, 同一优先级按创建顺序
+// 4. 只修改当前P的策略: 队列中已有的协程按新策略重新排列, 一个都不丢
+// 5. 无效的策略返回-1
+
+#define N 16
+#define ROUNDS 3
+#define DEPTH 10
+
+static int order[N * ROUNDS];
+static int norder = 0;
+
+void record_yield(void *arg) {
+    for (int i = 0; i < ROUNDS; i++) {
+        order[norder++] = (int)(long)arg;
+        co_yield();
+    }
+}
+
+void record(void *arg) {
+    order[norder++] = (int)(long)arg;
+}
+
+static void run_all(void (*func)(void *), const int *prio) {
+    norder = 0;
+    struct co *cos[N];
+    for (int i = 0; i < N; i++) {
+        struct co_attr attr = { .name = "rec", .stack_size = 0, .flags = 0, .priority = prio ? prio[i] : 0 };
+        cos[i] = co_start_attr(&attr, func, (void *)(long)i);
+    }
+    for (int i = 0; i < N; i++) {
+        co_wait(cos[i]);
+        co_release(cos[i]);
+    }
+}
+
+static int live = 0, max_live = 0;
+
+void tree(void *arg) {
+    long depth = (long)arg;
+    if (++live > max_live) max_live = live;
+    if (depth > 0) {
+        struct co *l = co_start("left", tree, (void *)(depth - 1));
+        struct co *r = co_start("right", tree, (void *)(depth - 1));
+        co_wait(l);
+        co_wait(r);
+        co_release(l);
+        co_release(r);
+    }
+    live--;
+}
+
+static int run_tree() {
+    live = max_live = 0;
+    struct co *root = co_start("root", tree, (void *)(long)DEPTH);
+    co_wait(root);
+    co_release(root);
+    return max_live;
+}
+
+int main() {
+    printf("=== 调度策略测试 ===\n");
+    co_set_gomaxprocs(1);
+
+    // 1. FIFO
+    co_set_sched_policy(CO_SCHED_FIFO);
+    run_all(record_yield, NULL);
+    int fifo_ok = co_get_sched_policy() == CO_SCHED_FIFO && norder == N * ROUNDS;
+    for (int i = 0; i < norder; i++) {
+        fifo_ok = fifo_ok && order[i] == i % N;
+    }
+    int fifo_tree = run_tree();
+    printf("FIFO: 轮流运行 %s, 二叉树同时存在 %d 个协程\n", fifo_ok ? "是" : "否", fifo_tree);
+
+    // 2. LIFO
+    co_set_sched_policy(CO_SCHED_LIFO);
+    run_all(record, NULL);
+    int lifo_ok = norder == N;
+    for (int i = 0; i < norder; i++) {
+        lifo_ok = lifo_ok && order[i] == N - 1 - i;
+    }
+    int lifo_tree = run_tree();
+    printf("LIFO: 倒序运行 %s, 二叉树同时存在 %d 个协程\n", lifo_ok ? "是" : "否", lifo_tree);
+    int tree_ok = lifo_tree <= 2 * DEPTH + 2 && fifo_tree > 4 * lifo_tree;
+
+    // 3. PRIORITY
+    co_set_sched_policy(CO_SCHED_PRIORITY);
+    int prio[N];
+    for (int i = 0; i < N; i++) {
+        prio[i] = (i * 5) % (CO_PRIO_MAX + 1);
+    }
+    run_all(record, prio);
+    int prio_ok = norder == N;
+    for (int i = 1; i < norder; i++) {
+        int a = order[i - 1], b = order[i];
+        prio_ok = prio_ok && (prio[a] > prio[b] || (prio[a] == prio[b] && a < b));
+    }
+    printf("PRIORITY: 按优先级运行 %s\n", prio_ok ? "是" : "否");
+
+    // 4. 队列中已有协程时切换当前P的策略
+    co_set_sched_policy(CO_SCHED_RANDOM);
+    norder = 0;
+    struct co *cos[N];
+    for (int i = 0; i < N; i++) {
+        struct co_attr attr = { .name = "rec", .stack_size = 0, .flags = 0, .priority = prio[i] };
+        cos[i] = co_start_attr(&attr, record, (void *)(long)i);
+    }
+    co_set_local_sched_policy(CO_SCHED_PRIORITY);
+    for (int i = 0; i < N; i++) {
+        co_wait(cos[i]);
+        co_release(cos[i]);
+    }
+    int switch_ok = norder == N && co_get_sched_policy() == CO_SCHED_PRIORITY;
+    for (int i = 1; i < norder; i++) {
+        switch_ok = switch_ok && prio[order[i - 1]] >= prio[order[i]];
+    }
+    printf("切换策略: %d / %d 个协程按优先级运行 %s\n", norder, N, switch_ok ? "是" : "否");
+
+    // 5. 无效策略
+    int invalid_ok = co_set_sched_policy(42) == -1 && co_set_local_sched_policy(-1) == -1;
+
+    if (fifo_ok && lifo_ok && tree_ok && prio_ok && switch_ok && invalid_ok) {
+        printf("调度策略测试 PASSED\n");
+        return 0;
+    }
+    printf("调度策略测试 FAILED\n");
+    return 1;
+}
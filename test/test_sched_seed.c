@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include "co.h"
+
+// 调度种子测试: 单个M上固定种子后运行同一负载, 记录协程的运行顺序,
+// 相同种子的两次运行顺序必须一致, 不同种子的顺序应当不同
+
+#define NUM_COROUTINES 20
+#define YIELDS 5
+#define TRACE_LEN (NUM_COROUTINES * (YIELDS + 1))
+
+static int trace[TRACE_LEN];
+static int trace_len = 0;
+
+void work(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i <= YIELDS; i++) {
+        trace[trace_len++] = id;
+        if (i < YIELDS) co_yield();
+    }
+}
+
+static void run(unsigned long long seed, int *out) {
+    co_set_sched_seed(seed);
+    trace_len = 0;
+
+    struct co *cos[NUM_COROUTINES];
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        cos[i] = co_start("seed", work, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        co_wait(cos[i]);
+    }
+    memcpy(out, trace, sizeof(trace));
+}
+
+int main() {
+    printf("=== 调度种子测试 ===\n");
+    co_set_gomaxprocs(1);  // 单个M
+    co_set_sched_policy(CO_SCHED_RANDOM);  // 只有随机策略使用种子
+
+    static int a[TRACE_LEN], b[TRACE_LEN], c[TRACE_LEN];
+    run(42, a);
+    run(42, b);
+    run(7, c);
+
+    int same = memcmp(a, b, sizeof(a)) == 0;
+    int differ = memcmp(a, c, sizeof(a)) != 0;
+    printf("相同种子顺序一致: %s, 不同种子顺序不同: %s\n", same ? "是" : "否", differ ? "是" : "否");
+    if (trace_len == TRACE_LEN && same && differ) {
+        printf("调度种子测试 PASSED\n");
+        return 0;
+    }
+    printf("调度种子测试 FAILED\n");
+    return 1;
+}
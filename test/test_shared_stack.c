@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+#include "co.h"
+
+#define NUM_SHARED 4
+#define NUM_PRIVATE 2
+#define ITERATIONS 50
+
+static int corrupted = 0;
+static int finished = 0;
+static struct co *shared_cos[NUM_SHARED];
+
+// 递归深度不同, 让每个协程在共享栈上占用不同大小的空间
+static void check_frames(int id, int depth) {
+    char frame[256];
+    memset(frame, id, sizeof(frame));
+    if (depth > 0) {
+        check_frames(id, depth - 1);
+    } else {
+        co_yield();
+    }
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        if (frame[i] != (char)id) {
+            corrupted++;
+            break;
+        }
+    }
+}
+
+void work(void *arg) {
+    int id = (int)(long)arg;
+    int local[64];
+    for (int i = 0; i < 64; i++) {
+        local[i] = id * 1000 + i;
+    }
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        check_frames(id, id % 5);
+        for (int j = 0; j < 64; j++) {
+            if (local[j] != id * 1000 + j) {
+                corrupted++;
+                break;
+            }
+        }
+    }
+
+    // 共享栈协程之间的等待
+    if (id == 1) {
+        co_wait(shared_cos[0]);
+    }
+    finished++;
+}
+
+int main() {
+    printf("=== 共享栈测试 ===\n");
+
+    struct co_attr shared = { .name = "shared", .stack_size = 0, .flags = CO_ATTR_SHARED_STACK };
+    for (int i = 0; i < NUM_SHARED; i++) {
+        shared_cos[i] = co_start_attr(&shared, work, (void *)(long)i);
+    }
+    struct co *private_cos[NUM_PRIVATE];
+    for (int i = 0; i < NUM_PRIVATE; i++) {
+        private_cos[i] = co_start("private", work, (void *)(long)(NUM_SHARED + i));
+    }
+
+    for (int i = 0; i < NUM_SHARED; i++) {
+        co_wait(shared_cos[i]);
+    }
+    for (int i = 0; i < NUM_PRIVATE; i++) {
+        co_wait(private_cos[i]);
+    }
+
+    printf("完成协程数: %d, 栈内容损坏次数: %d\n", finished, corrupted);
+    if (finished == NUM_SHARED + NUM_PRIVATE && corrupted == 0) {
+        printf("共享栈测试 PASSED\n");
+        return 0;
+    }
+    printf("共享栈测试 FAILED\n");
+    return 1;
+}
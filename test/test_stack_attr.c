@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "co.h"
+
+#define NUM_IDLE 2000
+#define SMALL_STACK (16 << 10)
+#define LARGE_STACK (1 << 20)
+#define RECURSION_DEPTH 400   // 每层约 1KB, 超过默认 64KB 栈
+
+static int recursion_result = 0;
+static long rss_before = 0;
+static long rss_after = 0;
+
+// 读取当前进程的RSS (KB)
+static long rss_kb() {
+    long size = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int deep(int n) {
+    volatile char frame[1024];
+    memset((char *)frame, 0, sizeof(frame));
+    if (n == 0) return frame[0];
+    return deep(n - 1) + frame[n % sizeof(frame)] + 1;
+}
+
+void deep_work(void *arg) {
+    (void)arg;
+    recursion_result = deep(RECURSION_DEPTH);
+}
+
+// 每个空闲协程创建下一个并等待它, 最后一个协程创建时所有协程都处于等待状态
+void idle_work(void *arg) {
+    long index = (long)arg;
+    if (index == NUM_IDLE - 1) {
+        rss_after = rss_kb();
+        return;
+    }
+    struct co_attr small = { .name = "idle", .stack_size = SMALL_STACK, .flags = 0 };
+    struct co *next = co_start_attr(&small, idle_work, (void *)(index + 1));
+    co_wait(next);
+}
+
+int main() {
+    printf("=== 协程属性与mmap栈测试 ===\n");
+
+    // 1. 大栈协程可以进行深递归
+    struct co_attr large = { .name = "deep", .stack_size = LARGE_STACK, .flags = 0 };
+    struct co *deep_co = co_start_attr(&large, deep_work, NULL);
+    co_wait(deep_co);
+    printf("深递归结果: %d\n", recursion_result);
+
+    // 2. 大量小栈空闲协程, 栈按需提交物理页
+    rss_before = rss_kb();
+    struct co_attr small = { .name = "idle", .stack_size = SMALL_STACK, .flags = 0 };
+    struct co *first = co_start_attr(&small, idle_work, (void *)0L);
+    co_wait(first);
+    double per_co = (double)(rss_after - rss_before) / NUM_IDLE;
+    printf("%d 个空闲协程 RSS 增长: %ld KB (每个协程 %.2f KB, 栈映射 %d KB)\n",
+           NUM_IDLE, rss_after - rss_before, per_co, SMALL_STACK >> 10);
+
+    if (recursion_result == RECURSION_DEPTH && per_co < SMALL_STACK / 1024) {
+        printf("协程属性与mmap栈测试 PASSED\n");
+        return 0;
+    }
+    printf("协程属性与mmap栈测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include "co.h"
+
+#define ROUNDS 100
+#define BATCH 10
+
+static int finished = 0;
+
+void short_work(void *arg) {
+    (void)arg;
+    co_yield();
+    finished++;
+}
+
+int main() {
+    printf("=== 栈缓存测试 ===\n");
+    co_set_gomaxprocs(1);  // 统计的是同一个P上的栈缓存, 不按需启动其它M
+
+    for (int r = 0; r < ROUNDS; r++) {
+        struct co *cos[BATCH];
+        for (int i = 0; i < BATCH; i++) {
+            cos[i] = co_start("short", short_work, NULL);
+        }
+        for (int i = 0; i < BATCH; i++) {
+            co_wait(cos[i]);
+        }
+    }
+
+    struct co_stack_stats stats;
+    co_get_stack_stats(&stats);
+    printf("完成协程数: %d\n", finished);
+    printf("栈缓存: hits=%lu misses=%lu spills=%lu refills=%lu\n",
+           stats.hits, stats.misses, stats.spills, stats.refills);
+
+    // 首轮之后的协程都应复用已结束协程的栈
+    if (finished == ROUNDS * BATCH &&
+        stats.hits + stats.misses == ROUNDS * BATCH &&
+        stats.misses <= BATCH) {
+        printf("栈缓存测试 PASSED\n");
+        return 0;
+    }
+    printf("栈缓存测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// 工作窃取压力测试: 多个M并发调度大量不断co_yield的协程,
+// 检查每个协程的每一步恰好执行一次, 且同一时刻不会在两个M上运行
+
+#define NUM_THREADS 3
+#define NUM_COROUTINES 1000
+#define YIELDS 20
+
+struct task {
+    atomic_int active;  // 协程正在某个M上运行
+    int steps;
+};
+
+static struct task tasks[NUM_COROUTINES];
+static atomic_int duplicated = 0;
+static atomic_int finished = 0;
+
+void work(void *arg) {
+    struct task *t = (struct task *)arg;
+    for (int i = 0; i < YIELDS; i++) {
+        int expected = 0;
+        if (!atomic_compare_exchange_strong(&t->active, &expected, 1)) {
+            atomic_fetch_add(&duplicated, 1);
+        }
+        t->steps++;
+        atomic_store(&t->active, 0);
+        co_yield();
+    }
+    atomic_fetch_add(&finished, 1);
+}
+
+// 工作线程的start_routine立即返回, 此后该M只负责调度和偷取
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 工作窃取压力测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        co_start("stress", work, &tasks[i]);
+    }
+    while (atomic_load(&finished) < NUM_COROUTINES) {
+        co_yield();
+    }
+
+    int lost = 0;
+    for (int i = 0; i < NUM_COROUTINES; i++) {
+        if (tasks[i].steps != YIELDS) lost++;
+    }
+
+    printf("完成协程: %d, 步数异常: %d, 重复运行: %d\n",
+           atomic_load(&finished), lost, atomic_load(&duplicated));
+    if (lost == 0 && atomic_load(&duplicated) == 0) {
+        printf("工作窃取压力测试 PASSED\n");
+        return 0;
+    }
+    printf("工作窃取压力测试 FAILED\n");
+    return 1;
+}
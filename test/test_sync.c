@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// 协程同步原语测试:
+// 1. co_mutex保护的计数器在多个M上结果准确, 持有者在临界区内让出时等待者挂起而不阻塞M
+// 2. co_cond实现的有界缓冲区, 生产者消费者不丢不重
+// 3. co_sem限制同时进入的协程数
+// 4. 等待超过1ms的协程让co_mutex进入饥饿模式, 反复加锁的持有者无法一直插队
+
+#define NUM_THREADS 3
+#define NUM_WORKERS 16
+#define INCREMENTS 2000
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define ITEMS 2000
+#define BUF_SIZE 4
+#define NUM_SEM_USERS 20
+#define SEM_LIMIT 3
+#define NUM_STARVED 4
+#define MS 1000000ULL
+
+static struct co_mutex counter_mutex = {0};
+static long counter = 0;
+
+void incrementer(void *arg) {
+    (void)arg;
+    for (int i = 0; i < INCREMENTS; i++) {
+        co_mutex_lock(&counter_mutex);
+        long v = counter;
+        if (i % 100 == 0) {
+            co_yield();  // 持有锁时让出, 同一M上的其它协程只能挂起等待
+        }
+        counter = v + 1;
+        co_mutex_unlock(&counter_mutex);
+    }
+}
+
+static struct co_mutex buf_mutex = {0};
+static struct co_cond not_empty = {0};
+static struct co_cond not_full = {0};
+static int buf[BUF_SIZE];
+static int buf_head = 0, buf_count = 0;
+static atomic_long consumed_sum = 0;
+static atomic_int consumed = 0;
+
+void producer(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = id; i < ITEMS; i += NUM_PRODUCERS) {
+        co_mutex_lock(&buf_mutex);
+        while (buf_count == BUF_SIZE) {
+            co_cond_wait(&not_full, &buf_mutex);
+        }
+        buf[(buf_head + buf_count) % BUF_SIZE] = i + 1;
+        buf_count++;
+        co_cond_signal(&not_empty);
+        co_mutex_unlock(&buf_mutex);
+    }
+}
+
+void consumer(void *arg) {
+    (void)arg;
+    while (1) {
+        co_mutex_lock(&buf_mutex);
+        while (buf_count == 0) {
+            co_cond_wait(&not_empty, &buf_mutex);
+        }
+        int item = buf[buf_head];
+        buf_head = (buf_head + 1) % BUF_SIZE;
+        buf_count--;
+        co_cond_signal(&not_full);
+        co_mutex_unlock(&buf_mutex);
+        if (item == 0) {
+            break;  // 结束标记
+        }
+        atomic_fetch_add(&consumed_sum, item);
+        atomic_fetch_add(&consumed, 1);
+    }
+}
+
+static struct co_sem sem;
+static atomic_int active = 0;
+static atomic_int max_active = 0;
+
+void sem_user(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 5; i++) {
+        co_sem_wait(&sem);
+        int now = atomic_fetch_add(&active, 1) + 1;
+        int max = atomic_load(&max_active);
+        while (now > max && !atomic_compare_exchange_weak(&max_active, &max, now)) {
+        }
+        co_sleep(MS);
+        atomic_fetch_sub(&active, 1);
+        co_sem_post(&sem);
+    }
+}
+
+static struct co_mutex starve_mutex = {0};
+static atomic_int holder_done = 0;
+static atomic_int waiter_got = 0;
+
+// 持锁睡眠2ms, 解锁后立即重新加锁, 被唤醒的等待者总是抢不到
+void greedy(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 10; i++) {
+        co_mutex_lock(&starve_mutex);
+        co_sleep(2 * MS);
+        co_mutex_unlock(&starve_mutex);
+    }
+    atomic_store(&holder_done, 1);
+}
+
+void starved(void *arg) {
+    (void)arg;
+    co_mutex_lock(&starve_mutex);
+    if (!atomic_load(&holder_done)) {
+        atomic_fetch_add(&waiter_got, 1);
+    }
+    co_mutex_unlock(&starve_mutex);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 协程同步原语测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    // 1. 互斥锁计数
+    struct co *workers[NUM_WORKERS];
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        workers[i] = co_start("incrementer", incrementer, NULL);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        co_wait(workers[i]);
+    }
+    printf("互斥锁: 计数 %ld / %d, 竞争 %lu 次, 直接交接 %lu 次\n", counter,
+           NUM_WORKERS * INCREMENTS, counter_mutex.contended, counter_mutex.handoffs);
+    int relocked = co_mutex_trylock(&counter_mutex);
+    if (relocked) {
+        co_mutex_unlock(&counter_mutex);
+    }
+    int mutex_ok = counter == NUM_WORKERS * INCREMENTS && counter_mutex.contended > 0 && relocked;
+
+    // 2. 条件变量: 有界缓冲区, 每个消费者收到一个0作为结束标记
+    struct co *prods[NUM_PRODUCERS], *cons[NUM_CONSUMERS];
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        cons[i] = co_start("consumer", consumer, NULL);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        prods[i] = co_start("producer", producer, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        co_wait(prods[i]);
+    }
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        co_mutex_lock(&buf_mutex);
+        while (buf_count == BUF_SIZE) {
+            co_cond_wait(&not_full, &buf_mutex);
+        }
+        buf[(buf_head + buf_count) % BUF_SIZE] = 0;
+        buf_count++;
+        co_cond_signal(&not_empty);
+        co_mutex_unlock(&buf_mutex);
+    }
+    for (int i = 0; i < NUM_CONSUMERS; i++) {
+        co_wait(cons[i]);
+    }
+    long expected_sum = (long)ITEMS * (ITEMS + 1) / 2;
+    printf("条件变量: 消费 %d / %d, 总和 %ld / %ld, 等待 %lu 次\n", atomic_load(&consumed), ITEMS,
+           atomic_load(&consumed_sum), expected_sum, not_empty.waits + not_full.waits);
+    int cond_ok = atomic_load(&consumed) == ITEMS && atomic_load(&consumed_sum) == expected_sum;
+
+    // 3. 信号量
+    co_sem_init(&sem, SEM_LIMIT);
+    struct co *users[NUM_SEM_USERS];
+    for (int i = 0; i < NUM_SEM_USERS; i++) {
+        users[i] = co_start("sem_user", sem_user, NULL);
+    }
+    for (int i = 0; i < NUM_SEM_USERS; i++) {
+        co_wait(users[i]);
+    }
+    int left = 0;
+    while (co_sem_trywait(&sem)) {
+        left++;
+    }
+    printf("信号量: 最多同时 %d 个 (上限 %d), 挂起 %lu 次, 剩余 %d\n",
+           atomic_load(&max_active), SEM_LIMIT, sem.contended, left);
+    int sem_ok = atomic_load(&max_active) == SEM_LIMIT && sem.contended > 0 && left == SEM_LIMIT;
+
+    // 4. 饥饿模式
+    struct co *g = co_start("greedy", greedy, NULL);
+    co_sleep(MS);  // 让greedy先拿到锁
+    struct co *starvers[NUM_STARVED];
+    for (int i = 0; i < NUM_STARVED; i++) {
+        starvers[i] = co_start("starved", starved, NULL);
+    }
+    co_wait(g);
+    for (int i = 0; i < NUM_STARVED; i++) {
+        co_wait(starvers[i]);
+    }
+    printf("饥饿模式: 持有者结束前拿到锁的等待者 %d / %d, 直接交接 %lu 次\n",
+           atomic_load(&waiter_got), NUM_STARVED, starve_mutex.handoffs);
+    int starve_ok = atomic_load(&waiter_got) == NUM_STARVED;
+
+    if (mutex_ok && cond_ok && sem_ok && starve_ok) {
+        printf("协程同步原语测试 PASSED\n");
+        return 0;
+    }
+    printf("协程同步原语测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// 定时器测试:
+// 1. 不同时长的co_sleep在同一个P上按到期顺序醒来, 且不早于要求的时间
+// 2. co_sleep不阻塞M: 同一M上的其它协程在睡眠期间继续运行
+// 3. co_wait_timeout: 目标先结束返回0, 先超时返回ETIMEDOUT
+// 4. 超时与目标结束同时发生时只唤醒一次, 所有等待者都能返回
+// 5. 所有M空闲时按最早的定时器休眠, 醒来时间接近要求的时间 (300ms需要从上层时间轮降层)
+
+#define NUM_THREADS 3
+#define NUM_SLEEPERS 32
+#define NUM_RACES 200
+#define MS 1000000ULL
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static atomic_int wake_order = 0;
+static int order[NUM_SLEEPERS];
+static atomic_int early = 0;
+
+void sleeper(void *arg) {
+    int i = (int)(long)arg;
+    uint64_t want = (uint64_t)(i + 1) * 2 * MS;
+    uint64_t start = now_ns();
+    co_sleep(want);
+    if (now_ns() - start < want) {
+        atomic_fetch_add(&early, 1);
+    }
+    order[i] = atomic_fetch_add(&wake_order, 1);
+}
+
+static atomic_int ticks = 0;
+static atomic_int ticks_during_sleep = 0;
+static atomic_int napping = 0;
+
+void napper(void *arg) {
+    (void)arg;
+    atomic_store(&napping, 1);
+    co_sleep(20 * MS);
+    atomic_store(&ticks_during_sleep, atomic_load(&ticks));
+    atomic_store(&napping, 0);
+}
+
+void ticker(void *arg) {
+    (void)arg;
+    while (!atomic_load(&napping)) {
+        co_yield();
+    }
+    while (atomic_load(&napping)) {
+        atomic_fetch_add(&ticks, 1);
+        co_yield();
+    }
+}
+
+void sleep_for(void *arg) {
+    co_sleep((uint64_t)(long)arg);
+}
+
+static atomic_int race_done = 0;
+static atomic_int race_finished = 0;
+static atomic_int race_timeout = 0;
+
+struct race {
+    struct co *target;
+    uint64_t timeout;
+};
+
+void racer(void *arg) {
+    struct race *race = arg;
+    int ret = co_wait_timeout(race->target, race->timeout);
+    if (ret == 0) {
+        atomic_fetch_add(&race_finished, 1);
+    } else if (errno == ETIMEDOUT) {
+        atomic_fetch_add(&race_timeout, 1);
+    }
+    atomic_fetch_add(&race_done, 1);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== 定时器测试 ===\n");
+    // 1. 按到期顺序醒来 (间隔2ms, 远大于刻度)。在同一个P的时间轮上检查,
+    //    不同P的定时器由不同线程处理, 醒来的先后还受操作系统调度影响
+    co_set_gomaxprocs(1);
+    struct co *cos[NUM_SLEEPERS];
+    for (int i = NUM_SLEEPERS - 1; i >= 0; i--) {
+        cos[i] = co_start("sleeper", sleeper, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_SLEEPERS; i++) {
+        co_wait(cos[i]);
+    }
+    int ordered = 1;
+    for (int i = 0; i < NUM_SLEEPERS; i++) {
+        if (order[i] != i) ordered = 0;
+    }
+    printf("睡眠: 提前醒来 %d, 按到期顺序 %s\n", atomic_load(&early), ordered ? "是" : "否");
+    int sleep_ok = atomic_load(&early) == 0 && ordered;
+
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    // 2. 睡眠不阻塞M
+    struct co *n = co_start("napper", napper, NULL);
+    struct co *t = co_start("ticker", ticker, NULL);
+    co_wait(n);
+    co_wait(t);
+    printf("睡眠期间其它协程运行了 %d 次\n", atomic_load(&ticks_during_sleep));
+    int nonblock_ok = atomic_load(&ticks_during_sleep) > 0;
+
+    // 3. co_wait_timeout
+    struct co *slow = co_start("slow", sleep_for, (void *)(long)(50 * MS));
+    uint64_t start = now_ns();
+    int r1 = co_wait_timeout(slow, 10 * MS);
+    int e1 = errno;
+    uint64_t waited1 = now_ns() - start;
+    int r2 = co_wait_timeout(slow, 1000 * MS);
+    uint64_t waited2 = now_ns() - start;
+    int r3 = co_wait_timeout(slow, 1000 * MS);
+    printf("超时等待: %d (%.1fms), 完成等待: %d (%.1fms), 已结束: %d\n",
+           r1, waited1 / 1e6, r2, waited2 / 1e6, r3);
+    int timeout_ok = r1 == -1 && e1 == ETIMEDOUT && waited1 >= 10 * MS &&
+                     r2 == 0 && waited2 >= 50 * MS && waited2 < 500 * MS && r3 == 0;
+
+    // 4. 超时与结束竞争: 超时时间在目标结束时间附近变化
+    for (int i = 0; i < NUM_RACES; i++) {
+        struct co *target = co_start("target", sleep_for, (void *)(long)(2 * MS));
+        struct race race = { target, MS + (i % 16) * 125000ULL };
+        struct co *a = co_start("racer", racer, &race);
+        struct co *b = co_start("racer", racer, &race);
+        co_wait(a);
+        co_wait(b);
+        co_wait(target);
+        co_release(a);
+        co_release(b);
+        co_release(target);
+    }
+    printf("竞争: 完成 %d (目标先结束 %d, 超时 %d)\n", atomic_load(&race_done),
+           atomic_load(&race_finished), atomic_load(&race_timeout));
+    int race_ok = atomic_load(&race_done) == 2 * NUM_RACES &&
+                  atomic_load(&race_finished) + atomic_load(&race_timeout) == 2 * NUM_RACES;
+
+    // 5. 所有M空闲时按截止时间休眠
+    struct co_sched_stats before, after;
+    co_get_sched_stats(&before);
+    start = now_ns();
+    co_sleep(300 * MS);
+    uint64_t slept = now_ns() - start;
+    co_get_sched_stats(&after);
+    printf("空闲睡眠 300ms: 实际 %.2fms, 期间休眠 %lu 次\n", slept / 1e6, after.parks - before.parks);
+    int park_ok = slept >= 300 * MS && slept < 350 * MS && after.parks > before.parks;
+
+    if (sleep_ok && nonblock_ok && timeout_ok && race_ok && park_ok) {
+        printf("定时器测试 PASSED\n");
+        return 0;
+    }
+    printf("定时器测试 FAILED\n");
+    return 1;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "co.h"
+
+// 调度事件追踪测试 (以 -DCO_TRACE 编译运行时): 两个协程交替yield,
+// 检查M0的事件环中创建/切换/yield/结束事件齐全, 时间戳单调, 环绕后只保留最近的事件
+
+#define YIELDS 3000
+#define MAX_EVENTS 8192
+
+static int yields[2];
+
+void work(void *arg) {
+    int *n = (int *)arg;
+    for (int i = 0; i < YIELDS; i++) {
+        (*n)++;
+        co_yield();
+    }
+}
+
+int main() {
+    printf("=== 调度事件追踪测试 ===\n");
+    co_set_gomaxprocs(1);  // 只检查M0的事件环
+
+    struct co *a = co_start("a", work, &yields[0]);
+    struct co *b = co_start("b", work, &yields[1]);
+    co_wait(a);
+    co_wait(b);
+
+    static struct co_trace_event events[MAX_EVENTS];
+    size_t n = co_trace_read(0, events, MAX_EVENTS);
+
+    int counts[CO_EV_UNPARK + 1] = {0};
+    int ordered = 1;
+    for (size_t i = 0; i < n; i++) {
+        counts[events[i].type]++;
+        if (i > 0 && events[i].ts_ns < events[i - 1].ts_ns) ordered = 0;
+    }
+
+    // 2*YIELDS次yield加上切换事件远超环的容量, 最早的创建事件已被覆盖
+    printf("读取事件: %zu, run=%d yield=%d wait=%d exit=%d, 时间有序: %s\n",
+           n, counts[CO_EV_RUN], counts[CO_EV_YIELD], counts[CO_EV_WAIT],
+           counts[CO_EV_EXIT], ordered ? "是" : "否");
+
+    // 只读取最近10个事件时, 最后一个事件与完整读取的相同
+    struct co_trace_event last = events[n - 1];
+    size_t small = co_trace_read(0, events, 10);
+    int tail_ok = small == 10 && events[9].ts_ns == last.ts_ns && events[9].type == last.type;
+
+    if (n == 4095 && ordered && counts[CO_EV_YIELD] > 1000 &&
+        counts[CO_EV_RUN] > 1000 && counts[CO_EV_EXIT] == 2 && tail_ok) {
+        FILE *null = fopen("/dev/null", "w");
+        co_trace_dump(null);
+        fclose(null);
+        printf("调度事件追踪测试 PASSED\n");
+        return 0;
+    }
+    printf("调度事件追踪测试 FAILED\n");
+    return 1;
+}
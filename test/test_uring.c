@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "co.h"
+
+// io_uring后端测试 (内核不支持时验证回退到epoll后的同样行为):
+// 1. 多个协程并发用co_read/co_write复制文件, 内容一致
+// 2. 协程在co_read上挂起时, 同一M上的其它协程继续运行
+// 3. 回环TCP上的echo, 多个M并发
+// 4. 切换回epoll后挂起读仍然正常
+
+#define NUM_THREADS 2
+#define NUM_FILES 8
+#define FILE_SIZE (256 * 1024)
+#define NUM_CLIENTS 16
+#define MESSAGES 50
+#define TICKS 100
+
+static char src_path[NUM_FILES][64];
+static char dst_path[NUM_FILES][64];
+static atomic_int copied = 0;
+
+void copier(void *arg) {
+    int i = (int)(long)arg;
+    int in = open(src_path[i], O_RDONLY);
+    int out = open(dst_path[i], O_WRONLY | O_TRUNC);
+    char buf[8192];
+    ssize_t n;
+    size_t total = 0;
+    while ((n = co_read(in, buf, sizeof(buf))) > 0) {
+        if (co_write(out, buf, n) != n) break;
+        total += n;
+    }
+    co_close(in);
+    co_close(out);
+    if (n == 0 && total == FILE_SIZE) {
+        atomic_fetch_add(&copied, 1);
+    }
+}
+
+static int files_equal(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    int equal = fa && fb;
+    while (equal) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) equal = 0;
+        if (ca == EOF || cb == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return equal;
+}
+
+static int pair[2];
+static atomic_int ticks = 0;
+static char received[16];
+static atomic_int ticks_at_read = -1;
+
+void reader(void *arg) {
+    (void)arg;
+    ssize_t n = co_read(pair[0], received, sizeof(received) - 1);
+    if (n > 0) received[n] = '\0';
+    atomic_store(&ticks_at_read, atomic_load(&ticks));
+}
+
+void ticker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < TICKS; i++) {
+        atomic_fetch_add(&ticks, 1);
+        co_yield();
+    }
+    co_write(pair[1], "hello", 5);
+}
+
+static int blocked_read() {
+    atomic_store(&ticks, 0);
+    atomic_store(&ticks_at_read, -1);
+    memset(received, 0, sizeof(received));
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+    struct co *r = co_start("reader", reader, NULL);
+    struct co *t = co_start("ticker", ticker, NULL);
+    co_wait(r);
+    co_wait(t);
+    co_close(pair[0]);
+    co_close(pair[1]);
+    printf("读取: \"%s\", 读取完成时ticker已运行 %d 次\n", received, atomic_load(&ticks_at_read));
+    return strcmp(received, "hello") == 0 && atomic_load(&ticks_at_read) == TICKS;
+}
+
+static int listen_fd;
+static struct sockaddr_in server_addr;
+static atomic_int echoed = 0;
+static atomic_int mismatched = 0;
+
+void echo_conn(void *arg) {
+    int fd = (int)(long)arg;
+    char buf[256];
+    ssize_t n;
+    while ((n = co_read(fd, buf, sizeof(buf))) > 0) {
+        co_write(fd, buf, n);
+    }
+    co_close(fd);
+}
+
+void acceptor(void *arg) {
+    (void)arg;
+    struct co_attr attr = { .name = "echo", .stack_size = 0, .flags = CO_ATTR_DETACHED };
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        int fd = co_accept(listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        co_start_attr(&attr, echo_conn, (void *)(long)fd);
+    }
+}
+
+void client(void *arg) {
+    int id = (int)(long)arg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (co_connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        atomic_fetch_add(&mismatched, 1);
+        co_close(fd);
+        return;
+    }
+    for (int i = 0; i < MESSAGES; i++) {
+        char msg[64], reply[64];
+        int len = snprintf(msg, sizeof(msg), "client %d message %d", id, i);
+        co_write(fd, msg, len);
+        int got = 0;
+        while (got < len) {
+            ssize_t n = co_read(fd, reply + got, len - got);
+            if (n <= 0) break;
+            got += n;
+        }
+        if (got != len || memcmp(msg, reply, len) != 0) {
+            atomic_fetch_add(&mismatched, 1);
+        } else {
+            atomic_fetch_add(&echoed, 1);
+        }
+    }
+    co_close(fd);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== io_uring后端测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    int backend = co_set_io_backend(CO_IO_URING);
+    printf("I/O后端: %s\n", backend == CO_IO_URING ? "io_uring" : "epoll (内核不支持io_uring)");
+    if (co_get_io_backend() != backend) {
+        printf("io_uring后端测试 FAILED\n");
+        return 1;
+    }
+
+    // 1. 并发复制文件
+    char *data = malloc(FILE_SIZE);
+    for (int i = 0; i < NUM_FILES; i++) {
+        strcpy(src_path[i], "/tmp/co_uring_src_XXXXXX");
+        strcpy(dst_path[i], "/tmp/co_uring_dst_XXXXXX");
+        int src = mkstemp(src_path[i]);
+        int dst = mkstemp(dst_path[i]);
+        for (int j = 0; j < FILE_SIZE; j++) {
+            data[j] = (char)(i * 31 + j * 7);
+        }
+        ssize_t ret = write(src, data, FILE_SIZE);
+        (void)ret;
+        close(src);
+        close(dst);
+    }
+    free(data);
+    struct co *copiers[NUM_FILES];
+    for (int i = 0; i < NUM_FILES; i++) {
+        copiers[i] = co_start("copier", copier, (void *)(long)i);
+    }
+    int same = 0;
+    for (int i = 0; i < NUM_FILES; i++) {
+        co_wait(copiers[i]);
+        same += files_equal(src_path[i], dst_path[i]);
+        unlink(src_path[i]);
+        unlink(dst_path[i]);
+    }
+    printf("文件复制: 完成 %d, 内容一致 %d / %d\n", atomic_load(&copied), same, NUM_FILES);
+    int copy_ok = atomic_load(&copied) == NUM_FILES && same == NUM_FILES;
+
+    // 2. 读挂起时其它协程继续运行
+    int read_ok = blocked_read();
+
+    // 3. 回环echo
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = 0;
+    bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
+    socklen_t len = sizeof(server_addr);
+    getsockname(listen_fd, (struct sockaddr *)&server_addr, &len);
+    listen(listen_fd, 128);
+
+    struct co *acc = co_start("acceptor", acceptor, NULL);
+    struct co *clients[NUM_CLIENTS];
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        clients[i] = co_start("client", client, (void *)(long)i);
+    }
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        co_wait(clients[i]);
+    }
+    co_wait(acc);
+    co_close(listen_fd);
+    printf("echo: 成功 %d, 失败 %d\n", atomic_load(&echoed), atomic_load(&mismatched));
+    int echo_ok = atomic_load(&echoed) == NUM_CLIENTS * MESSAGES && atomic_load(&mismatched) == 0;
+
+    // 4. 切换回epoll
+    co_set_io_backend(CO_IO_EPOLL);
+    int epoll_ok = co_get_io_backend() == CO_IO_EPOLL && blocked_read();
+
+    if (copy_ok && read_ok && echo_ok && epoll_ok) {
+        printf("io_uring后端测试 PASSED\n");
+        return 0;
+    }
+    printf("io_uring后端测试 FAILED\n");
+    return 1;
+}
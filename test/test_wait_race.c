@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "co.h"
+
+// co_wait 竞争测试: 多个M上大量父协程等待刚创建的子协程,
+// 子协程可能被偷取到其它M上, 与父协程的co_wait同时结束;
+// 检查每个父协程都被唤醒且恰好一次, 子协程都先于父协程返回前结束
+
+#define NUM_THREADS 3
+#define NUM_PARENTS 2000
+#define CHILDREN 3
+
+static atomic_int children_done = 0;
+static atomic_int parents_done = 0;
+static atomic_int early_wakeups = 0;
+
+void child(void *arg) {
+    atomic_int *done = (atomic_int *)arg;
+    // 不同的子协程在不同时刻结束, 覆盖等待前/等待中结束的情况
+    for (int i = 0; i < atomic_load(&children_done) % 3; i++) {
+        co_yield();
+    }
+    atomic_fetch_add(done, 1);
+    atomic_fetch_add(&children_done, 1);
+}
+
+void parent(void *arg) {
+    (void)arg;
+    atomic_int done = 0;
+    struct co *kids[CHILDREN];
+    for (int i = 0; i < CHILDREN; i++) {
+        kids[i] = co_start("child", child, &done);
+        co_yield();  // 让子协程有机会被其它M偷取
+    }
+    for (int i = 0; i < CHILDREN; i++) {
+        co_wait(kids[i]);
+    }
+    if (atomic_load(&done) != CHILDREN) {
+        atomic_fetch_add(&early_wakeups, 1);
+    }
+    atomic_fetch_add(&parents_done, 1);
+}
+
+void* idle_thread(void *arg) {
+    (void)arg;
+    return NULL;
+}
+
+int main() {
+    printf("=== co_wait 竞争测试 ===\n");
+    co_set_gomaxprocs(NUM_THREADS + 1);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        co_thread(idle_thread, NULL);
+    }
+
+    static struct co *parents[NUM_PARENTS];
+    for (int i = 0; i < NUM_PARENTS; i++) {
+        parents[i] = co_start("parent", parent, NULL);
+    }
+    for (int i = 0; i < NUM_PARENTS; i++) {
+        co_wait(parents[i]);
+    }
+
+    printf("父协程完成: %d, 子协程完成: %d, 提前唤醒: %d\n",
+           atomic_load(&parents_done), atomic_load(&children_done), atomic_load(&early_wakeups));
+    if (atomic_load(&parents_done) == NUM_PARENTS &&
+        atomic_load(&children_done) == NUM_PARENTS * CHILDREN &&
+        atomic_load(&early_wakeups) == 0) {
+        printf("co_wait 竞争测试 PASSED\n");
+        return 0;
+    }
+    printf("co_wait 竞争测试 FAILED\n");
+    return 1;
+}